@@ -0,0 +1,15 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+using UnrealBuildTool;
+
+/** Engine agnostic projectile simulation. Must only ever depend on Core */
+public class ProjectileCore : ModuleRules
+{
+	public ProjectileCore(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+		CppStandard = CppStandardVersion.Cpp20;
+		PublicIncludePaths.Add(ModuleDirectory);
+		PublicDependencyModuleNames.AddRange(new string[] { "Core" });
+	}
+}
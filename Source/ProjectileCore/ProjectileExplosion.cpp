@@ -0,0 +1,86 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileExplosion.h"
+
+void ClusterProjectileExplosions(TArrayView<const FProjectileExplosion> Explosions, float MaxClusterRadius,
+	TArray<FProjectileExplosionCluster>& OutClusters, TArray<uint32>& OutClusterIndices, TArray<uint32>& OutMembers)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ClusterProjectileExplosions);
+
+	OutClusters.Reset();
+	OutClusterIndices.SetNumUninitialized(Explosions.Num(), false);
+	OutMembers.SetNumUninitialized(Explosions.Num(), false);
+
+	// NOTE(dennis): greedy, every explosion joins the first cluster it fits in. volleys land in a handful
+	// of spots so the cluster count stays tiny and this is cheaper than anything smarter
+	for (int32 I = 0; I < Explosions.Num(); ++I)
+	{
+		const FProjectileExplosion& Explosion = Explosions[I];
+
+		int32 ClusterIndex = INDEX_NONE;
+		for (int32 C = 0; C < OutClusters.Num(); ++C)
+		{
+			FProjectileExplosionCluster& Cluster = OutClusters[C];
+			if (Cluster.ConfigId != Explosion.ConfigId || Cluster.OwnerId != Explosion.OwnerId)
+			{
+				continue;
+			}
+
+			// smallest sphere around both the cluster and the explosion
+			FVector Delta = Explosion.Location - Cluster.Center;
+			float Dist = (float)Delta.Size();
+			if (Dist + Explosion.Radius <= Cluster.Radius)
+			{
+				ClusterIndex = C;
+			}
+			else if (Dist + Cluster.Radius <= Explosion.Radius)
+			{
+				if (Explosion.Radius <= MaxClusterRadius)
+				{
+					Cluster.Center = Explosion.Location;
+					Cluster.Radius = Explosion.Radius;
+					ClusterIndex = C;
+				}
+			}
+			else
+			{
+				float Radius = (Dist + Cluster.Radius + Explosion.Radius) * 0.5f;
+				if (Radius <= MaxClusterRadius)
+				{
+					Cluster.Center += Delta * ((Radius - Cluster.Radius) / Dist);
+					Cluster.Radius = Radius;
+					ClusterIndex = C;
+				}
+			}
+
+			if (ClusterIndex != INDEX_NONE)
+			{
+				++Cluster.MemberCount;
+				break;
+			}
+		}
+
+		if (ClusterIndex == INDEX_NONE)
+		{
+			ClusterIndex = OutClusters.Num();
+			OutClusters.Add({ Explosion.Location, Explosion.Radius, Explosion.ConfigId, Explosion.OwnerId, 0, 1 });
+		}
+
+		OutClusterIndices[I] = (uint32)ClusterIndex;
+	}
+
+	// counting sort the explosions by cluster
+	uint32 Offset = 0;
+	for (FProjectileExplosionCluster& Cluster : OutClusters)
+	{
+		Cluster.FirstMember = Offset;
+		Offset += Cluster.MemberCount;
+		Cluster.MemberCount = 0;
+	}
+
+	for (int32 I = 0; I < Explosions.Num(); ++I)
+	{
+		FProjectileExplosionCluster& Cluster = OutClusters[OutClusterIndices[I]];
+		OutMembers[Cluster.FirstMember + Cluster.MemberCount++] = (uint32)I;
+	}
+}
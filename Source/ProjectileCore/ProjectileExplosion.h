@@ -0,0 +1,33 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Explosive projectile that hit something this tick */
+struct FProjectileExplosion
+{
+	FVector				Location;		// where the projectile was when it hit
+	float				Radius;			// FProjectileSimParams::ExplosionRadius
+	uint16				ConfigId;
+	uint16				OwnerId;
+};
+
+/** Explosions close enough together to share one overlap query */
+struct FProjectileExplosionCluster
+{
+	FVector				Center;			// the sphere around every member explosion
+	float				Radius;
+	uint16				ConfigId;		// only explosions of the same config and owner are merged
+	uint16				OwnerId;		// so the damage can be credited to whoever fired them
+	uint32				FirstMember;	// into the members array
+	uint32				MemberCount;
+};
+
+/**
+ * Merges explosions of the same config and owner into clusters no larger than MaxClusterRadius, an explosion bigger than that
+ * gets a cluster of its own. OutClusterIndices is the cluster of every explosion, OutMembers holds indices into
+ * Explosions grouped by cluster. the output arrays are reset, not freed, so keeping them around avoids allocating every frame
+ */
+PROJECTILECORE_API void ClusterProjectileExplosions(TArrayView<const FProjectileExplosion> Explosions, float MaxClusterRadius,
+	TArray<FProjectileExplosionCluster>& OutClusters, TArray<uint32>& OutClusterIndices, TArray<uint32>& OutMembers);
@@ -5,20 +5,36 @@
 #include "CoreMinimal.h"
 
 /** Handle to a specific projectile */
-struct PROJECTILEPERF_API FProjectileHandle
+struct PROJECTILECORE_API FProjectileHandle
 {
 	uint16 Index;		// handle lookup index
 	uint16 Version;		// version number for the handle
+
+	/** never refers to a projectile, handed out when no more projectiles fit */
+	static FProjectileHandle Invalid()
+	{
+		return { TNumericLimits<uint16>::Max(), 0 };
+	}
+
+	friend bool operator==(FProjectileHandle A, FProjectileHandle B)
+	{
+		return A.Index == B.Index && A.Version == B.Version;
+	}
+
+	friend uint32 GetTypeHash(FProjectileHandle Handle)
+	{
+		return ((uint32)Handle.Version << 16) | (uint32)Handle.Index;
+	}
 };
 
 /** Where to find the projectile internal data inside the manager */
-struct PROJECTILEPERF_API FHandleLookup
+struct PROJECTILECORE_API FHandleLookup
 {
 	uint16 Opaque;	// implementation specific bytes
 };
 
 /** Table of handles that can be used in a "weak pointer" way to access a piece of data */
-struct PROJECTILEPERF_API FHandleTable
+struct PROJECTILECORE_API FHandleTable
 {
 	TArray<FHandleLookup>	Lookup;		// opaque lookup data associated with a handle
 	TArray<uint16>			Version;	// internal version number to compare against
@@ -27,22 +43,28 @@ struct PROJECTILEPERF_API FHandleTable
 
 	/** create the table */
 	void Init(uint32 InMaxCount);
+	/** adds handles up to NewMaxCount, the ones given out stay valid. never shrinks */
+	void Grow(uint32 NewMaxCount);
 
 	/** get internal lookup data for the handle. doesn't test for valid */
 	FHandleLookup* Get(FProjectileHandle Handle);
 
-	/** allocates a new handle from the available pool*/
+	/** allocates a new handle from the available pool. FProjectileHandle::Invalid if there are none left */
 	FProjectileHandle Claim();
 	/** frees an existing handle and returns it to the pool. doesn't test for valid */
 	void Release(FProjectileHandle Handle);
 	/** test if a handle is pointing to anything valid by comparing the version numbers */
 	bool IsValid(FProjectileHandle Handle) const;
+	/** number of handles that can still be claimed */
+	uint32 GetFreeCount() const { return (uint32)FreeIndex.Num(); }
 };
 
 // ------------------------------------------------------
 
 FORCEINLINE void FHandleTable::Init(uint32 InMaxCount) 
 {
+	// the last index is what FProjectileHandle::Invalid points to
+	check(InMaxCount < TNumericLimits<uint16>::Max());
 	MaxCount = InMaxCount;
 
 	Lookup.Init({}, MaxCount);
@@ -57,6 +79,27 @@ FORCEINLINE void FHandleTable::Init(uint32 InMaxCount)
 	}
 }
 
+FORCEINLINE void FHandleTable::Grow(uint32 NewMaxCount)
+{
+	if (NewMaxCount <= MaxCount)
+	{
+		return;
+	}
+	check(NewMaxCount < TNumericLimits<uint16>::Max());
+
+	Lookup.SetNumZeroed(NewMaxCount);
+	Version.SetNumZeroed(NewMaxCount);
+
+	// the new indices are popped next, in ascending order like Init
+	FreeIndex.Reserve(FreeIndex.Num() + NewMaxCount - MaxCount);
+	for (uint32 I = NewMaxCount; I-- > MaxCount;)
+	{
+		FreeIndex.Push((uint16)I);
+	}
+
+	MaxCount = NewMaxCount;
+}
+
 FORCEINLINE FHandleLookup* FHandleTable::Get(FProjectileHandle Handle)
 {
 	return &Lookup[Handle.Index];
@@ -64,6 +107,11 @@ FORCEINLINE FHandleLookup* FHandleTable::Get(FProjectileHandle Handle)
 
 FORCEINLINE FProjectileHandle FHandleTable::Claim()
 {
+	if (FreeIndex.Num() == 0)
+	{
+		return FProjectileHandle::Invalid();
+	}
+
 	FProjectileHandle Handle;
 	Handle.Index = FreeIndex.Pop(false);
 	Handle.Version = Version[Handle.Index];
@@ -80,6 +128,11 @@ FORCEINLINE void FHandleTable::Release(FProjectileHandle Handle)
 
 FORCEINLINE bool FHandleTable::IsValid(FProjectileHandle Handle) const
 {
+	if (Handle.Index >= MaxCount)
+	{
+		return false;
+	}
+
 	uint16 TrueVersion = Version[Handle.Index];
 	return (TrueVersion == Handle.Version);
 }
@@ -0,0 +1,1935 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileSimulation.h"
+#include "Templates/IntegerSequence.h"
+#include "Algo/Sort.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+TRACE_DECLARE_INT_COUNTER(ProjectileTraces, TEXT("Projectile/Traces"));
+TRACE_DECLARE_INT_COUNTER(ProjectileStaticTraces, TEXT("Projectile/StaticTraces"));
+TRACE_DECLARE_INT_COUNTER(ProjectileDynamicTraces, TEXT("Projectile/DynamicTraces"));
+TRACE_DECLARE_INT_COUNTER(ProjectileStaticTracesAvoided, TEXT("Projectile/StaticTracesAvoided"));
+TRACE_DECLARE_INT_COUNTER(ProjectileSegmentTraces, TEXT("Projectile/SegmentTraces"));
+TRACE_DECLARE_INT_COUNTER(ProjectileStepTracesAvoided, TEXT("Projectile/StepTracesAvoided"));
+TRACE_DECLARE_INT_COUNTER(ProjectileSimulated, TEXT("Projectile/Simulated"));
+TRACE_DECLARE_INT_COUNTER(ProjectileFrozen, TEXT("Projectile/Frozen"));
+TRACE_DECLARE_INT_COUNTER(ProjectileBallistic, TEXT("Projectile/Ballistic"));
+TRACE_DECLARE_INT_COUNTER(ProjectileExpired, TEXT("Projectile/Expired"));
+TRACE_DECLARE_INT_COUNTER(ProjectileRejected, TEXT("Projectile/Rejected"));
+TRACE_DECLARE_INT_COUNTER(ProjectileEvicted, TEXT("Projectile/Evicted"));
+
+struct FProjectileHandleLookup
+{
+	uint8 Chunk; // index of the chunk in the manager
+	uint8 Index; // index inside the chunk
+};
+
+static_assert(sizeof(FProjectileHandleLookup) == sizeof(FHandleLookup));
+
+FORCEINLINE FProjectileHandleLookup UnpackHandleLookup(FHandleLookup* Lookup)
+{
+	// FProjectileHandleLookup and FHandleLookup are bitwise the same in this implementation
+	union 
+	{
+		FHandleLookup A;
+		FProjectileHandleLookup B;
+	} Cast = { .A = *Lookup };
+
+	return Cast.B;
+}
+
+FORCEINLINE FHandleLookup PackHandleLookup(FProjectileHandleLookup* Lookup)
+{
+	// FProjectileHandleLookup and FHandleLookup are bitwise the same in this implementation
+	union 
+	{
+		FHandleLookup A;
+		FProjectileHandleLookup B;
+	} Cast = { .B = *Lookup };
+
+	return Cast.A;
+}
+
+struct BumpAllocator
+{
+	uint32 Pos;
+
+	template<typename T>
+	uint32 Bump(uint32 Count = 1)
+	{
+		uint32 AlignedPos = Align(Pos, alignof(T));
+		uint32 Bytes = sizeof(T) * Count;
+		Pos += Bytes;
+		return AlignedPos;
+	}
+};
+
+static FProjectileChunk CreateProjectileChunk(uint16 ConfigId)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(CreateProjectileChunk);
+
+	FProjectileChunk Chunk = {};
+	Chunk.ConfigId = ConfigId;
+	Chunk.Count = 0;
+
+	// figure out memory size requirements and the offsets to each array inside of that block
+	BumpAllocator Alloc = { 0 };
+	uint32 StatesOffset = Alloc.Bump<FProjectileState>(MAX_CHUNK_PROJECTILE_COUNT);
+	uint32 HandlesOffset = Alloc.Bump<FProjectileHandle>(MAX_CHUNK_PROJECTILE_COUNT);
+	uint32 OwnerIdsOffset = Alloc.Bump<uint16>(MAX_CHUNK_PROJECTILE_COUNT);
+	uint32 TargetIdsOffset = Alloc.Bump<uint16>(MAX_CHUNK_PROJECTILE_COUNT);
+	uint32 LookaheadsOffset = Alloc.Bump<FProjectileLookahead>(MAX_CHUNK_PROJECTILE_COUNT);
+	uint32 PrevPositionsOffset = Alloc.Bump<FVector>(MAX_CHUNK_PROJECTILE_COUNT);
+
+	// allocate a single memory block to fit everything
+	uint32 DataAlignment = (uint32)FPlatformMemory::GetConstants().PageSize;
+	uint8* DataPtr = (uint8*)FMemory::MallocZeroed(Alloc.Pos, DataAlignment);
+	Chunk.DataPtr = DataPtr;
+	Chunk.DataSize = Alloc.Pos;
+
+	// assign the pointers
+	Chunk.States = (FProjectileState*)(DataPtr + StatesOffset);
+	Chunk.Handles = (FProjectileHandle*)(DataPtr + HandlesOffset);
+	Chunk.OwnerIds = (uint16*)(DataPtr + OwnerIdsOffset);
+	Chunk.TargetIds = (uint16*)(DataPtr + TargetIdsOffset);
+	Chunk.Lookaheads = (FProjectileLookahead*)(DataPtr + LookaheadsOffset);
+	Chunk.PrevPositions = (FVector*)(DataPtr + PrevPositionsOffset);
+
+	return Chunk;
+}
+
+/** copies every per-projectile array entry from one slot to another */
+FORCEINLINE void CopyProjectileSlot(const FProjectileChunk* Src, uint32 From, FProjectileChunk* Dst, uint32 To)
+{
+	Dst->States[To] = Src->States[From];
+	Dst->Handles[To] = Src->Handles[From];
+	Dst->OwnerIds[To] = Src->OwnerIds[From];
+	Dst->TargetIds[To] = Src->TargetIds[From];
+	Dst->Lookaheads[To] = Src->Lookaheads[From];
+	Dst->PrevPositions[To] = Src->PrevPositions[From];
+}
+
+FORCEINLINE void MoveProjectileSlot(FProjectileChunk* Chunk, uint32 From, uint32 To)
+{
+	CopyProjectileSlot(Chunk, From, Chunk, To);
+}
+
+/** swaps every per-projectile array entry of two slots in the same chunk */
+FORCEINLINE void SwapProjectileSlots(FProjectileChunk* Chunk, uint32 A, uint32 B)
+{
+	Swap(Chunk->States[A], Chunk->States[B]);
+	Swap(Chunk->Handles[A], Chunk->Handles[B]);
+	Swap(Chunk->OwnerIds[A], Chunk->OwnerIds[B]);
+	Swap(Chunk->TargetIds[A], Chunk->TargetIds[B]);
+	Swap(Chunk->Lookaheads[A], Chunk->Lookaheads[B]);
+	Swap(Chunk->PrevPositions[A], Chunk->PrevPositions[B]);
+}
+
+/** points the handle of the projectile in a slot back to that slot, after it was moved there */
+FORCEINLINE void UpdateHandleLookup(FHandleTable& HandleTable, const FProjectileChunk* Chunk, uint32 ChunkIndex, uint32 Index)
+{
+	FProjectileHandleLookup Lookup;
+	Lookup.Chunk = (uint8)ChunkIndex;
+	Lookup.Index = (uint8)Index;
+	*HandleTable.Get(Chunk->Handles[Index]) = PackHandleLookup(&Lookup);
+}
+
+/** swaps the per-projectile arrays of two chunks, everything else stays */
+static void SwapProjectileChunkData(FProjectileChunk* A, FProjectileChunk* B)
+{
+	Swap(A->DataPtr, B->DataPtr);
+	Swap(A->States, B->States);
+	Swap(A->Handles, B->Handles);
+	Swap(A->OwnerIds, B->OwnerIds);
+	Swap(A->TargetIds, B->TargetIds);
+	Swap(A->Lookaheads, B->Lookaheads);
+	Swap(A->PrevPositions, B->PrevPositions);
+}
+
+static void DestroyProjectileChunk(FProjectileChunk* Chunk)
+{
+	FMemory::Free(Chunk->DataPtr);
+	*Chunk = {};
+}
+
+FProjectileSimulation::FProjectileSimulation()
+	: bDeterministic(false)
+	, FixedTimestep(1.0f / 60.0f)
+	, TimeAccumulator(0.0f)
+	, StepNumber(0)
+	, StateHash(0)
+	, MaxRetargetsPerFrame(256)
+	, RetargetChunkCursor(0)
+	, bTickInFlight(false)
+	, TickChunkCount(0)
+	, TickSubstepCount(0)
+	, TickStepDt(0.0f)
+	, TickGravityZ(0.0f)
+	, TickWorld(nullptr)
+	, bSpatialIndexDirty(true)
+	, MaxChunkSortsPerFrame(4)
+	, SortChunkCursor(0)
+	, SortScratch{}
+	, bPublishSnapshots(false)
+	, StreamingCellSize(0.0f)
+	, SaturationHeadroom(0)
+	, ReservedPriority(0)
+	, RejectedSinceTick(0)
+{
+}
+
+FProjectileSimulation::~FProjectileSimulation()
+{
+	Shutdown();
+}
+
+void FProjectileSimulation::Init(uint32 MaxHandles)
+{
+	check(MaxHandles <= MAX_PROJECTILE_HANDLES);
+	HandleTable.Init(MaxHandles);
+
+	// chunks can be created while a tick is in flight, they must never move
+	Chunks.Reserve(MAX_CHUNK_COUNT);
+
+	TimeAccumulator = 0.0f;
+	StepNumber = 0;
+	StateHash = 0;
+
+	// target id 0 means no target
+	Targets.Reset();
+	Targets.Add({ FVector::ZeroVector, false });
+	FreeTargetIds.Reset();
+	RetargetChunkCursor = 0;
+}
+
+void FProjectileSimulation::Shutdown()
+{
+	check(!bTickInFlight);
+
+	// cleanup all chunks
+	for (FProjectileChunk& It : Chunks)
+	{
+		DestroyProjectileChunk(&It);
+	}
+
+	Chunks.Reset();
+	DestroyProjectileChunk(&SortScratch);
+	Configs.Reset();
+	TickConfigs.Reset();
+	Targets.Reset();
+	TickTargets.Reset();
+	FreeTargetIds.Reset();
+	PendingDestroys.Reset();
+	Kills.Reset();
+	TickDebugLinesLeft.Reset();
+	Explosions.Reset();
+	UnloadedCells.Reset();
+	OccupiedCells.Reset();
+	TickOccupiedCells.Reset();
+	EvictionFocus.Reset();
+	EvictionCandidates.Reset();
+	RejectedSinceTick = 0;
+}
+
+uint16 FProjectileSimulation::AddConfig(const FProjectileSimParams& Params)
+{
+	check(Configs.Num() < TNumericLimits<uint16>::Max());
+	return (uint16)Configs.Add(Params);
+}
+
+uint32 FProjectileSimulation::ReserveProjectiles(uint16 ConfigId, uint32 Count)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::ReserveProjectiles);
+
+	uint32 Capacity = 0;
+	for (const FProjectileChunk& It : Chunks)
+	{
+		if (It.ConfigId == ConfigId)
+		{
+			Capacity += MAX_CHUNK_PROJECTILE_COUNT - It.Count;
+		}
+	}
+
+	// empty chunks are picked up by GetOrCreateChunk once nothing closer has space
+	uint32 CreatedCount = 0;
+	while (Capacity < Count && Chunks.Num() < MAX_CHUNK_COUNT)
+	{
+		Chunks.Add(CreateProjectileChunk(ConfigId));
+		Capacity += MAX_CHUNK_PROJECTILE_COUNT;
+		++CreatedCount;
+	}
+
+	// the sort gathers into a chunk of its own
+	if (MaxChunkSortsPerFrame > 0 && !SortScratch.DataPtr)
+	{
+		SortScratch = CreateProjectileChunk(0);
+	}
+
+	// and every tick copies the configs
+	TickConfigs.Reserve(Configs.Num());
+	TickDebugLinesLeft.Reserve(Configs.Num());
+
+	return CreatedCount;
+}
+
+uint32 FProjectileSimulation::ReserveHandles(uint32 Count)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::ReserveHandles);
+
+	// the sweep task adds to Kills
+	check(!bTickInFlight);
+
+	Count = FMath::Clamp(Count, 1u, (uint32)MAX_PROJECTILE_HANDLES);
+
+	// a handle that was ever given out has to stay valid or stale, re-creating the table would reset its version
+	bool bUntouched = (uint32)HandleTable.FreeIndex.Num() == HandleTable.MaxCount
+		&& !HandleTable.Version.ContainsByPredicate([](uint16 Version) { return Version != 0; });
+	if (!bUntouched)
+	{
+		HandleTable.Grow(Count);
+	}
+	else if (Count != HandleTable.MaxCount)
+	{
+		HandleTable.Init(Count);
+	}
+
+	// room for every projectile to die in the same tick
+	Kills.Reserve(HandleTable.MaxCount);
+	DestroyEvents.Reserve(HandleTable.MaxCount);
+	Explosions.Reserve(HandleTable.MaxCount);
+	PendingDestroys.Reserve(HandleTable.MaxCount);
+
+	return HandleTable.MaxCount;
+}
+
+uint64 FProjectileSimulation::GetAllocatedBytes() const
+{
+	uint64 Bytes = SortScratch.DataSize;
+	for (const FProjectileChunk& It : Chunks)
+	{
+		Bytes += It.DataSize;
+	}
+	return Bytes;
+}
+
+int32 FProjectileSimulation::GetOrCreateChunk(uint16 ConfigId, const FVector& Location)
+{
+	// find an existing chunk with enough space, preferring the ones already flying around here
+	// so a chunk stays spatially coherent and its traces touch the same part of the world.
+	// empty chunks have no bounds and are only used if nothing else has space
+	int32 BestIndex = INDEX_NONE;
+	double BestDistSq = 0.0;
+
+	for (int32 I = 0; I < Chunks.Num(); ++I)
+	{
+		FProjectileChunk& It = Chunks[I];
+		if (It.ConfigId == ConfigId && It.Count < MAX_CHUNK_PROJECTILE_COUNT)
+		{
+			double DistSq = It.Bounds.IsValid ? It.Bounds.ComputeSquaredDistanceToPoint(Location) : TNumericLimits<double>::Max();
+			if (BestIndex == INDEX_NONE || DistSq < BestDistSq)
+			{
+				BestIndex = I;
+				BestDistSq = DistSq;
+			}
+
+			if (DistSq == 0.0)
+			{
+				break;
+			}
+		}
+	}
+
+	if (BestIndex != INDEX_NONE)
+	{
+		return BestIndex;
+	}
+
+	// or create a new chunk if we couldn't find a suitable one.
+	// the sweep task reads Chunks while a tick is in flight, growing past the reserve would move it under the task
+	if (Chunks.Num() >= MAX_CHUNK_COUNT)
+	{
+		return INDEX_NONE;
+	}
+
+	check(Chunks.Num() < Chunks.Max());
+	FProjectileChunk Tmp = CreateProjectileChunk(ConfigId);
+	int32 Index = Chunks.Add(MoveTemp(Tmp));
+	return Index;
+}
+
+FProjectileHandle FProjectileSimulation::CreateProjectile(uint16 ConfigId,
+	const FVector& Location, const FRotator& Rotation, uint16 OwnerId)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::CreateProjectile);
+
+	FProjectileState State = {};
+	State.Position = Location;
+	State.Rotation = FRotator3f(Rotation);
+	State.Velocity = FRotator3f(Rotation).Vector() * Configs[ConfigId].InitialSpeed;
+	State.Lifetime = 0.0f;
+
+	return CreateProjectileFromState(ConfigId, State, OwnerId);
+}
+
+FProjectileHandle FProjectileSimulation::CreateProjectileFromState(uint16 ConfigId,
+	const FProjectileState& InState, uint16 OwnerId)
+{
+	// creating a projectile is as simple as grabbing a new handle,
+	// finding the chunk the projectile needs to go into,
+	// incrementing the chunk counter, which also gives us the index in that chunk,
+	// which finally gives us the lookup data.
+	// then just get the state and initialize the projectile data.
+	// done.
+
+	// when saturated only the high priority spawns get to use the headroom,
+	// the low priority ones are rejected instead of hitching or running out for everyone
+	uint32 FreeCount = HandleTable.GetFreeCount();
+	if (FreeCount == 0 || (FreeCount <= SaturationHeadroom && Configs[ConfigId].Priority < ReservedPriority))
+	{
+		++RejectedSinceTick;
+		return FProjectileHandle::Invalid();
+	}
+
+	// find an existing chunk with enough space
+	// or create a new chunk if we couldn't find a suitable one
+	int32 ChunkIndex = GetOrCreateChunk(ConfigId, InState.Position);
+	if (ChunkIndex == INDEX_NONE)
+	{
+		++RejectedSinceTick;
+		return FProjectileHandle::Invalid();
+	}
+
+	FProjectileHandle Handle = HandleTable.Claim();
+	FHandleLookup* LookupPtr = HandleTable.Get(Handle);
+	FProjectileHandleLookup Lookup = UnpackHandleLookup(LookupPtr);
+	
+	FProjectileChunk *Chunk = &Chunks[ChunkIndex];
+
+	// increment the counter to get the index
+	uint32 IndexInChunk = Chunk->Count++;
+
+	// initialize the projectile
+	Chunk->States[IndexInChunk] = InState;
+	Chunk->Bounds += InState.Position;
+
+	// update the handle lookup data
+	Lookup.Chunk = (uint8)ChunkIndex;
+	Lookup.Index = (uint8)IndexInChunk;
+	*LookupPtr = PackHandleLookup(&Lookup);
+
+	Chunk->Handles[IndexInChunk] = Handle;
+	Chunk->OwnerIds[IndexInChunk] = OwnerId;
+	Chunk->TargetIds[IndexInChunk] = 0;
+	Chunk->Lookaheads[IndexInChunk] = {};
+	Chunk->PrevPositions[IndexInChunk] = InState.Position;
+
+	bSpatialIndexDirty = true;
+
+	return Handle;
+}
+
+void FProjectileSimulation::DestroyProjectile(FProjectileHandle Handle)
+{
+	if (bDeterministic || bTickInFlight)
+	{
+		// the swap-remove below makes the chunk layout depend on the order of destroys,
+		// which depends on whoever happened to call us first. defer them and apply
+		// them in a stable order at the start of the next tick instead.
+		// a tick in flight owns the chunks, so those are deferred until it ends
+		if (HandleTable.IsValid(Handle))
+		{
+			PendingDestroys.Add(Handle);
+		}
+	}
+	else
+	{
+		DestroyProjectileImmediate(Handle, EProjectileDestroyReason::Explicit);
+	}
+}
+
+void FProjectileSimulation::FlushPendingDestroys()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::FlushPendingDestroys);
+
+	// handle indices are handed out deterministically, so they give us a stable order
+	PendingDestroys.Sort([](const FProjectileHandle& A, const FProjectileHandle& B)
+	{
+		return A.Index < B.Index;
+	});
+
+	for (FProjectileHandle Handle : PendingDestroys)
+	{
+		// duplicates are fine, the second destroy sees an invalid handle
+		DestroyProjectileImmediate(Handle, EProjectileDestroyReason::Explicit);
+	}
+
+	PendingDestroys.Reset();
+}
+
+void FProjectileSimulation::DestroyProjectileImmediate(FProjectileHandle Handle, EProjectileDestroyReason Reason, const FVector* Location)
+{
+	if (HandleTable.IsValid(Handle))
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::DestroyProjectile);
+
+		// when destroying a projectile, we don't want "gaps" in the array.
+		// destroy a projectile by just swapping the last projectile in the array
+		// and decrement the counter
+		//
+		// |P1|P2|P3|P4|
+		// ------------> count: 4
+		//
+		// destroying P2 creates a "gap" in the array
+		// |P1|  |P3|P4|
+		// ------------> count: 4
+		// 
+		// so we move P4 into that slot instead to fill it and decrement the counter
+		// |P1|P4|P3|  |
+		// --------> count: 3
+		//
+		// this requires us to update the handle lookup for P4 to point into index 2
+		//
+		// TODO(dennis): in theory we would also want a compaction step to keep each chunk compact
+		// we might have two chunks with the exact same config with a low count in each
+		// this should be packed to fill one of the chunks, basically move from one chunk to another
+
+		FHandleLookup* ThisLookupPtr = HandleTable.Get(Handle);
+		FProjectileHandleLookup ThisLookup = UnpackHandleLookup(ThisLookupPtr);
+		FProjectileChunk *Chunk = &Chunks[ThisLookup.Chunk];
+
+		check(!Chunk->bInsideTick);
+
+		// owners are notified in bulk later, we just record what happened
+		uint16 OwnerId = Chunk->OwnerIds[ThisLookup.Index];
+		if (OwnerId != 0)
+		{
+			FProjectileDestroyEvent& Event = DestroyEvents.AddUninitialized_GetRef();
+			Event.Handle = Handle;
+			Event.OwnerId = OwnerId;
+			Event.Reason = Reason;
+			Event.Location = Location ? *Location : Chunk->States[ThisLookup.Index].Position;
+		}
+
+		float ExplosionRadius = Configs[Chunk->ConfigId].ExplosionRadius;
+		if (Reason == EProjectileDestroyReason::Hit && ExplosionRadius > 0.0f)
+		{
+			FProjectileExplosion& Explosion = Explosions.AddUninitialized_GetRef();
+			Explosion.Location = Location ? *Location : Chunk->States[ThisLookup.Index].Position;
+			Explosion.Radius = ExplosionRadius;
+			Explosion.ConfigId = Chunk->ConfigId;
+			Explosion.OwnerId = OwnerId;
+		}
+
+		// decrement the projectile counter
+		uint32 LastProjIndex = --Chunk->Count;
+		// get the last handle + lookup in this chunk that we are going to swap with
+		FProjectileHandle LastHandle = Chunk->Handles[LastProjIndex];
+		FHandleLookup* LastLookupPtr = HandleTable.Get(LastHandle);
+		// move the lookup so the last index handle now points to the destroyed projectile slot
+		*LastLookupPtr = *ThisLookupPtr;
+
+		// move the projectile state, handle and the rest from the last index to the destroyed index
+		MoveProjectileSlot(Chunk, LastProjIndex, ThisLookup.Index);
+
+		HandleTable.Release(Handle);
+
+		bSpatialIndexDirty = true;
+	}
+}
+
+bool FProjectileSimulation::RemoveProjectile(FProjectileHandle Handle, EProjectileDestroyReason Reason,
+	FProjectileState& OutState, uint16& OutConfigId, uint16& OutOwnerId)
+{
+	if (!HandleTable.IsValid(Handle))
+	{
+		return false;
+	}
+
+	FProjectileHandleLookup Lookup = UnpackHandleLookup(HandleTable.Get(Handle));
+	const FProjectileChunk* Chunk = &Chunks[Lookup.Chunk];
+
+	OutState = Chunk->States[Lookup.Index];
+	OutConfigId = Chunk->ConfigId;
+	OutOwnerId = Chunk->OwnerIds[Lookup.Index];
+
+	DestroyProjectileImmediate(Handle, Reason);
+	return true;
+}
+
+FProjectileState* FProjectileSimulation::GetProjectileState(FProjectileHandle Handle)
+{
+	if (HandleTable.IsValid(Handle))
+	{
+		FProjectileHandleLookup Lookup = UnpackHandleLookup(HandleTable.Get(Handle));
+		FProjectileChunk* Chunk = &Chunks[Lookup.Chunk];
+		FProjectileState* State = Chunk->States + Lookup.Index;
+		return State;
+	}
+	else
+	{
+		// if the handle is invalid, we still return a valid pointer to something
+		// so that the caller can continue as normal without doing any error checking
+		// if the wish to actually make sure that the projectile is valid, then they should use
+		// FProjectileSimulation::IsProjectileValid
+		static FProjectileState GStubState;
+		return &GStubState;
+	}
+}
+
+bool FProjectileSimulation::IsProjectileValid(FProjectileHandle Handle) const
+{
+	return HandleTable.IsValid(Handle);
+}
+
+void FProjectileSimulation::ClearOwner(uint16 OwnerId)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::ClearOwner);
+
+	for (FProjectileChunk& Chunk : Chunks)
+	{
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			if (Chunk.OwnerIds[I] == OwnerId)
+			{
+				Chunk.OwnerIds[I] = 0;
+			}
+		}
+	}
+
+	DestroyEvents.RemoveAllSwap([OwnerId](const FProjectileDestroyEvent& Event)
+	{
+		return Event.OwnerId == OwnerId;
+	});
+
+	// the explosions still go off, nobody gets the credit
+	for (FProjectileExplosion& Explosion : Explosions)
+	{
+		if (Explosion.OwnerId == OwnerId)
+		{
+			Explosion.OwnerId = 0;
+		}
+	}
+}
+
+uint16 FProjectileSimulation::AddTarget(const FVector& Location)
+{
+	uint16 TargetId;
+	if (FreeTargetIds.Num() > 0)
+	{
+		TargetId = FreeTargetIds.Pop(false);
+	}
+	else if (Targets.Num() < MAX_PROJECTILE_TARGETS)
+	{
+		TargetId = (uint16)Targets.AddUninitialized();
+	}
+	else
+	{
+		return 0;
+	}
+
+	Targets[TargetId] = { Location, true };
+	return TargetId;
+}
+
+void FProjectileSimulation::RemoveTarget(uint16 TargetId)
+{
+	if (TargetId != 0 && Targets.IsValidIndex(TargetId) && Targets[TargetId].bValid)
+	{
+		Targets[TargetId].bValid = false;
+		FreeTargetIds.Add(TargetId);
+	}
+}
+
+void FProjectileSimulation::SetTargetLocation(uint16 TargetId, const FVector& Location)
+{
+	if (TargetId != 0 && Targets.IsValidIndex(TargetId))
+	{
+		Targets[TargetId].Location = Location;
+	}
+}
+
+void FProjectileSimulation::UpdateSpatialIndex()
+{
+	// nobody queried, nothing built. while a tick is in flight the old index is all we can offer
+	if (bSpatialIndexDirty && !bTickInFlight)
+	{
+		SpatialIndex.Build(Chunks.GetData(), (uint32)Chunks.Num());
+		bSpatialIndexDirty = false;
+	}
+}
+
+void FProjectileSimulation::QueryRadius(const FVector& Center, float Radius, TArray<FProjectileHandle>& OutHandles)
+{
+	UpdateSpatialIndex();
+	SpatialIndex.QueryRadius(Center, Radius, OutHandles);
+}
+
+void FProjectileSimulation::QueryBox(const FBox& Box, TArray<FProjectileHandle>& OutHandles)
+{
+	UpdateSpatialIndex();
+	SpatialIndex.QueryBox(Box, OutHandles);
+}
+
+void FProjectileSimulation::QuerySegment(const FVector& Start, const FVector& End, float Radius, TArray<FProjectileHandle>& OutHandles)
+{
+	UpdateSpatialIndex();
+	SpatialIndex.QuerySegment(Start, End, Radius, OutHandles);
+}
+
+/** spreads the lower 10 bits of V out to every third bit */
+FORCEINLINE uint32 ExpandMortonBits(uint32 V)
+{
+	V = (V * 0x00010001u) & 0xFF0000FFu;
+	V = (V * 0x00000101u) & 0x0F00F00Fu;
+	V = (V * 0x00000011u) & 0xC30C30C3u;
+	V = (V * 0x00000005u) & 0x49249249u;
+	return V;
+}
+
+void FProjectileSimulation::SortChunk(uint32 ChunkIndex)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::SortChunk);
+
+	FProjectileChunk* Chunk = &Chunks[ChunkIndex];
+	check(!Chunk->bInsideTick);
+
+	uint32 Count = Chunk->Count;
+	if (Count < 2)
+	{
+		return;
+	}
+
+	if (!SortScratch.DataPtr)
+	{
+		SortScratch = CreateProjectileChunk(0);
+	}
+
+	FBox Bounds(ForceInit);
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		Bounds += Chunk->States[I].Position;
+	}
+
+	// 10 bits per axis inside the chunk bounds, the slot goes in the low bits so sorting
+	// the keys gives us the new order directly
+	FVector Scale = FVector(1023.0) / Bounds.GetSize().ComponentMax(FVector(UE_KINDA_SMALL_NUMBER));
+
+	static uint64 Keys[MAX_CHUNK_PROJECTILE_COUNT];
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		FVector Cell = (Chunk->States[I].Position - Bounds.Min) * Scale;
+		uint32 Code = (ExpandMortonBits((uint32)Cell.X) << 2) | (ExpandMortonBits((uint32)Cell.Y) << 1) | ExpandMortonBits((uint32)Cell.Z);
+		Keys[I] = ((uint64)Code << 8) | I;
+	}
+
+	Algo::Sort(MakeArrayView(Keys, Count));
+
+	bool bAlreadySorted = true;
+	for (uint32 I = 0; I < Count && bAlreadySorted; ++I)
+	{
+		bAlreadySorted = (Keys[I] & 0xFF) == I;
+	}
+
+	if (bAlreadySorted)
+	{
+		return;
+	}
+
+	// gather into the scratch chunk in the new order and swap the memory with it
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		CopyProjectileSlot(Chunk, (uint32)(Keys[I] & 0xFF), &SortScratch, I);
+	}
+
+	SwapProjectileChunkData(Chunk, &SortScratch);
+
+	// every projectile moved, point the handles to their new slot
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		UpdateHandleLookup(HandleTable, Chunk, ChunkIndex, I);
+	}
+
+	Chunk->Bounds = Bounds;
+}
+
+void FProjectileSimulation::PartitionUnloaded(uint32 ChunkIndex)
+{
+	FProjectileChunk* Chunk = &Chunks[ChunkIndex];
+	Chunk->TickActiveCount = Chunk->TickCount;
+
+	// chunks are spatially coherent, most of them don't come near an unloaded cell
+	bool bTouchesUnloaded = false;
+	for (const FIntPoint& Cell : UnloadedCells)
+	{
+		FVector2D Min = FVector2D(Cell) * StreamingCellSize;
+		FBox2D CellBox(Min, Min + FVector2D(StreamingCellSize));
+		if (CellBox.Intersect(FBox2D(FVector2D(Chunk->Bounds.Min), FVector2D(Chunk->Bounds.Max))))
+		{
+			bTouchesUnloaded = true;
+			break;
+		}
+	}
+
+	if (!bTouchesUnloaded)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::PartitionUnloaded);
+
+	// swap the unloaded ones to the end so the kernels keep running over one contiguous range
+	uint32 ActiveCount = Chunk->TickCount;
+	for (uint32 I = 0; I < ActiveCount;)
+	{
+		if (UnloadedCells.Contains(GetStreamingCell(Chunk->States[I].Position)))
+		{
+			--ActiveCount;
+			SwapProjectileSlots(Chunk, I, ActiveCount);
+			UpdateHandleLookup(HandleTable, Chunk, ChunkIndex, I);
+			UpdateHandleLookup(HandleTable, Chunk, ChunkIndex, ActiveCount);
+
+			// the geometry it cached may not be there anymore, or not yet
+			Chunk->Lookaheads[ActiveCount] = {};
+		}
+		else
+		{
+			++I;
+		}
+	}
+
+	Chunk->TickActiveCount = ActiveCount;
+}
+
+uint32 FProjectileSimulation::ComputeStateHash() const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::ComputeStateHash);
+
+	// hash the state fields one by one, FProjectileState is padded out to a cache line
+	// and nothing keeps those padding bytes in sync between two runs
+	static_assert(sizeof(FProjectileHandle) == sizeof(uint16) * 2, "FProjectileHandle must not have padding");
+
+	uint32 Hash = 0;
+	for (const FProjectileChunk& Chunk : Chunks)
+	{
+		Hash = FCrc::MemCrc32(&Chunk.Count, sizeof(Chunk.Count), Hash);
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			const FProjectileState& State = Chunk.States[I];
+			Hash = FCrc::MemCrc32(&State.Position, sizeof(State.Position), Hash);
+			Hash = FCrc::MemCrc32(&State.Rotation, sizeof(State.Rotation), Hash);
+			Hash = FCrc::MemCrc32(&State.Velocity, sizeof(State.Velocity), Hash);
+			Hash = FCrc::MemCrc32(&State.Lifetime, sizeof(State.Lifetime), Hash);
+			Hash = FCrc::MemCrc32(&State.Bounces, sizeof(State.Bounces), Hash);
+			Hash = FCrc::MemCrc32(&State.Penetrations, sizeof(State.Penetrations), Hash);
+		}
+		Hash = FCrc::MemCrc32(Chunk.Handles, sizeof(FProjectileHandle) * Chunk.Count, Hash);
+	}
+
+	return Hash;
+}
+
+uint32 FProjectileSimParams::GetKernelFeatures(float GravityZ) const
+{
+	uint32 Features = 0;
+	Features |= (GravityZ * GravityScale != 0.0f) ? PKF_Gravity : 0;
+	Features |= (DragCoefficient > 0.0f) ? PKF_Drag : 0;
+	Features |= !Wind.IsZero() ? PKF_Wind : 0;
+	Features |= (MaxSpeed > 0.0f) ? PKF_MaxSpeed : 0;
+	Features |= bRotationFollowsVelocity ? PKF_Rotation : 0;
+	Features |= (MaxLifetime != 0.0f) ? PKF_Lifetime : 0;
+	Features |= (bHoming && TurnRate > 0.0f) ? PKF_Homing : 0;
+	return Features;
+}
+
+/** per step values shared by every projectile in a chunk */
+struct FProjectileStepParams
+{
+	float		StepDt;
+	FVector3f	ConstantAcc;	// gravity + wind, folded together once per chunk
+	float		MaxSpeed;
+	float		DragCoefficient;
+	float		MaxLifetime;
+	bool		bDebugDraw;
+	uint32*		DebugLinesLeft;	// shared by every chunk with the same config
+	const uint32* SkipBits;		// slots killed by an earlier substep, they don't draw. null if none
+	bool		bResolveHits;	// the config can survive hits (ricochet/penetration)
+	float		MaxTurnAngle;	// radians a homing projectile can turn this step
+	const FProjectileTarget* Targets;
+	const FProjectileSimParams* Config;
+};
+
+template<uint32 Features>
+FORCEINLINE FVector3f CalcProjectileVelocity(float DeltaTime, FVector3f V0, const FProjectileStepParams& Params)
+{
+	// v = v0 + a*t
+	FVector3f V1 = V0;
+
+	if constexpr ((Features & (PKF_Gravity | PKF_Wind)) != 0)
+	{
+		V1 += Params.ConstantAcc * DeltaTime;
+	}
+
+	if constexpr ((Features & PKF_Drag) != 0)
+	{
+		// evaluated at v0, the step is small enough that this is stable for sane coefficients
+		V1 -= V0 * (Params.DragCoefficient * V0.Size() * DeltaTime);
+	}
+
+	if constexpr ((Features & PKF_MaxSpeed) != 0)
+	{
+		V1 = V1.GetClampedToMaxSize(Params.MaxSpeed);
+	}
+
+	return V1;
+}
+
+/** whether projectile I is one of the sampled ones and still fits in the debug line budget */
+FORCEINLINE bool ShouldDrawProjectileDebug(const FProjectileChunk* Chunk, uint32 I, const FProjectileStepParams& Params)
+{
+	// sample by handle index so the same projectiles get drawn every step and leave whole trails
+	if (Chunk->Handles[I].Index % Params.Config->DebugSampleRate != 0 || *Params.DebugLinesLeft == 0)
+	{
+		return false;
+	}
+
+	// killed ones sit still until the tick ends, their lines would only eat the budget
+	if (Params.SkipBits && (Params.SkipBits[I >> 5] & (1u << (I & 31))))
+	{
+		return false;
+	}
+
+	--*Params.DebugLinesLeft;
+	return true;
+}
+
+// how far to move away from a surface after resolving a hit so the next trace doesn't start inside it
+#define PROJECTILE_SURFACE_OFFSET (0.1f)
+
+/**
+ * tries to keep the projectile alive after a blocking hit by ricocheting or going through the surface,
+ * then continues the rest of the step with a bounded number of traces.
+ * P1/V1 are the position/velocity at the impact and are updated in place. returns false if the projectile dies
+ */
+static bool ResolveProjectileHit(FProjectileState* State, FVector& P1, FVector3f& V1, FProjectileHit Hit,
+	float RemainingDt, const FProjectileStepParams& Params, IProjectileCollisionWorld& World, bool bDrawDebug)
+{
+	const FProjectileSimParams* Config = Params.Config;
+
+	for (uint32 Retrace = 0; Retrace < MAX_PROJECTILE_RETRACES; ++Retrace)
+	{
+		float Speed = V1.Size();
+		FVector3f Dir = Speed > UE_KINDA_SMALL_NUMBER ? V1 / Speed : FVector3f::ZeroVector;
+		float Depth = Hit.SurfaceType < MAX_PROJECTILE_SURFACE_TYPES ? Config->PenetrationDepth[Hit.SurfaceType] : 0.0f;
+
+		if (State->Penetrations < Config->MaxPenetrations && Depth > 0.0f && Speed > UE_KINDA_SMALL_NUMBER)
+		{
+			// trace backwards from as deep as we can go. if that ends up outside the surface
+			// the hit is the exit point, otherwise the surface is too thick
+			FVector Probe = P1 + FVector(Dir * Depth);
+			FProjectileHit Exit = World.TraceSegment(Probe, P1);
+			if (!Exit.bBlockingHit || Exit.bStartPenetrating)
+			{
+				return false;
+			}
+
+			P1 = Probe + (P1 - Probe) * Exit.Time + FVector(Dir * PROJECTILE_SURFACE_OFFSET);
+			V1 *= Config->PenetrationSpeedRetention;
+			++State->Penetrations;
+		}
+		else if (State->Bounces < Config->MaxBounces && Speed >= Config->MinBounceSpeed)
+		{
+			// reflect, losing some of the normal and tangential velocity
+			FVector3f Normal = Hit.Normal;
+			FVector3f NormalVel = Normal * FVector3f::DotProduct(V1, Normal);
+			FVector3f TangentVel = V1 - NormalVel;
+			V1 = TangentVel * (1.0f - Config->BounceFriction) - NormalVel * Config->Restitution;
+
+			P1 += FVector(Normal * PROJECTILE_SURFACE_OFFSET);
+			++State->Bounces;
+		}
+		else
+		{
+			return false;
+		}
+
+		// continue the remaining part of the step in a straight line, the acceleration
+		// over what's left of a substep is small enough to ignore
+		FVector End = P1 + FVector(V1 * RemainingDt);
+		Hit = World.TraceSegment(P1, End);
+
+		if (bDrawDebug)
+		{
+			World.DrawDebugLine(P1, P1 + (End - P1) * Hit.Time, Config->DebugColor);
+		}
+
+		if (Hit.bStartPenetrating)
+		{
+			return false;
+		}
+
+		P1 = P1 + (End - P1) * Hit.Time;
+		if (!Hit.bBlockingHit)
+		{
+			return true;
+		}
+
+		RemainingDt *= 1.0f - Hit.Time;
+	}
+
+	// out of traces for this step, rest at the last impact and resolve it next step
+	return true;
+}
+
+/** stage 1: compute the MoveDelta to use for the sweep stage */
+template<uint32 Features>
+static void IntegrateChunk(FProjectileChunk* Chunk, uint32 ProjCount, const FProjectileStepParams& Params,
+	FVector3f* MoveDeltas)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(IntegrateChunk);
+
+	float StepDt = Params.StepDt;
+
+	if constexpr ((Features & PKF_Homing) != 0)
+	{
+		// steer first, in its own pass over the chunk, so the integration below stays branch free
+		for (uint32 I = 0; I < ProjCount; ++I)
+		{
+			FProjectileState* State = Chunk->States + I;
+			const FProjectileTarget& Target = Params.Targets[Chunk->TargetIds[I]];
+
+			// id 0 is never valid, so this also skips projectiles without a target
+			if (Target.bValid)
+			{
+				FVector3f V0 = State->Velocity;
+				float Speed = V0.Size();
+				FVector3f Dir = V0.GetSafeNormal();
+				FVector3f ToTarget = FVector3f(Target.Location - State->Position).GetSafeNormal(UE_SMALL_NUMBER, Dir);
+
+				// turn at most MaxTurnAngle. normalized lerp is close enough to a slerp for the small angle of one step
+				float Angle = FMath::Acos(FMath::Clamp(FVector3f::DotProduct(Dir, ToTarget), -1.0f, 1.0f));
+				float Alpha = Angle > Params.MaxTurnAngle ? Params.MaxTurnAngle / Angle : 1.0f;
+				FVector3f NewDir = (Dir + (ToTarget - Dir) * Alpha).GetSafeNormal(UE_SMALL_NUMBER, Dir);
+
+				State->Velocity = NewDir * Speed;
+			}
+		}
+	}
+
+	for (uint32 I = 0; I < ProjCount; ++I)
+	{
+		FProjectileState* State = Chunk->States + I;
+
+		// Velocity Verlet integration (http://en.wikipedia.org/wiki/Verlet_integration#Velocity_Verlet)
+		// The addition of p0 is done outside this method, we are just computing the delta.
+		// p = p0 + v0*t + 1/2*a*t^2
+		
+		// v = v0 + a*t
+		FVector3f Vel = CalcProjectileVelocity<Features>(StepDt, State->Velocity, Params);
+		// p = v0*t + 1/2*a*t^2
+		FVector3f Delta = (State->Velocity * StepDt) + (Vel - State->Velocity) * (0.5f * StepDt);
+
+		if constexpr ((Features & PKF_Rotation) != 0)
+		{
+			// NOTE(dennis): this is actually  expensive
+			// 2x arctanf
+			// 1x sqrtf
+			State->Rotation = Vel.Rotation();
+		}
+		
+		MoveDeltas[I] = Delta;
+	}
+}
+
+/** stage 3: handle hit result and compute final velocity. returns number of slots to destroy */
+template<uint32 Features>
+static uint32 FinalizeChunk(FProjectileChunk* Chunk, uint32 ProjCount, const FProjectileStepParams& Params,
+	const FVector3f* MoveDeltas, const FProjectileHit* Hits, IProjectileCollisionWorld& World,
+	uint8* DestroySlots, EProjectileDestroyReason* DestroyReasons)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FinalizeChunk);
+
+	uint32 DestroyCount = 0;
+	float StepDt = Params.StepDt;
+
+	for (uint32 I = 0; I < ProjCount; ++I)
+	{
+		FProjectileState* State = Chunk->States + I;
+		FVector3f MoveDelta = MoveDeltas[I];
+		FProjectileHit Hit = Hits[I];
+		
+		bool bMarkForKill = false;
+		EProjectileDestroyReason KillReason = EProjectileDestroyReason::Lifetime;
+		
+		// add p0 to the verlet integration from the first update
+		// p = p0 + v0*t + 1/2*a*t^2
+		FVector P0 = State->Position;
+		FVector P1 = P0 + FVector(MoveDelta * Hit.Time);
+
+		// v = v0 + a*t
+		FVector3f V0 = State->Velocity;
+		// take the hit time into account when calculating velocity
+		float VelTime = StepDt * Hit.Time;
+		FVector3f V1 = CalcProjectileVelocity<Features>(VelTime, V0, Params);
+
+		// branches using the config are going to be 100% predictable
+		// since every single projectile in this Chunk use the exact same one
+		bool bDrawDebug = Params.bDebugDraw && ShouldDrawProjectileDebug(Chunk, I, Params);
+		if (bDrawDebug)
+		{
+			World.DrawDebugLine(P0, P1, Params.Config->DebugColor);
+		}
+
+		bool bHitSomething = Hit.bBlockingHit || Hit.bStartPenetrating;
+		if (bHitSomething)
+		{
+			// ricochets and penetrations are resolved right here so the projectile keeps its handle and slot
+			bool bSurvived = Params.bResolveHits && !Hit.bStartPenetrating
+				&& ResolveProjectileHit(State, P1, V1, Hit, StepDt - VelTime, Params, World, bDrawDebug);
+
+			if (!bSurvived)
+			{
+				bMarkForKill = true;
+				KillReason = EProjectileDestroyReason::Hit;
+			}
+
+			// TODO(dennis): here you handle projectile impact events
+		}
+
+		State->Position = P1;
+		State->Velocity = V1;
+
+		State->Lifetime += StepDt;
+
+		if constexpr ((Features & PKF_Lifetime) != 0)
+		{
+			// destroy projectile when lifetime exceeded
+			if (State->Lifetime >= Params.MaxLifetime)
+			{
+				bMarkForKill = true;
+			}
+		}
+
+		if (bMarkForKill)
+		{
+			DestroyReasons[DestroyCount] = KillReason;
+			DestroySlots[DestroyCount++] = (uint8)I;
+		}
+	}
+
+	return DestroyCount;
+}
+
+/** hits were traced for a compacted list of slots, spreads them back out to their slots. skipped slots hit nothing */
+static void ScatterSkippedHits(FProjectileHit* Hits, const uint8* Slots, uint32 TraceCount, uint32 ProjCount, const uint32* SkipBits)
+{
+	// every slot is at or after its compacted index, going backwards never overwrites one still to be moved
+	for (uint32 K = TraceCount; K-- > 0;)
+	{
+		Hits[Slots[K]] = Hits[K];
+	}
+
+	for (uint32 I = 0; I < ProjCount; ++I)
+	{
+		if (SkipBits[I >> 5] & (1u << (I & 31)))
+		{
+			Hits[I] = {};
+			Hits[I].Time = 1.0f;
+		}
+	}
+}
+
+/**
+ * stage 2 for configs with a trace error tolerance: instead of tracing every step, a projectile traces the chord of
+ * as many upcoming steps as its trajectory stays within the tolerance of. if that comes back clear the steps aren't
+ * traced at all, if it hits something they're traced one by one like usual.
+ * SegmentEnds/ClearBits carry the segment of every projectile over the substeps of a tick.
+ * slots in SkipBits (can be null) are neither traced nor hit anything
+ */
+static void TraceChunkAdaptive(FProjectileChunk* Chunk, uint32 ProjCount, const FProjectileStepParams& Params,
+	uint32 Step, uint32 SubstepCount, uint8* SegmentEnds, uint32* ClearBits, const uint32* SkipBits, const FVector3f* MoveDeltas,
+	IProjectileCollisionWorld& World, FVector* TraceStarts, FVector* TraceEnds, FProjectileHit* Hits, FProjectileSimStats& Stats)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(TraceChunkAdaptive);
+
+	static uint8 SegmentSlots[MAX_CHUNK_PROJECTILE_COUNT];
+	static FVector SegmentStarts[MAX_CHUNK_PROJECTILE_COUNT];
+	static FVector SegmentEndPoints[MAX_CHUNK_PROJECTILE_COUNT];
+	static FProjectileHit SegmentHits[MAX_CHUNK_PROJECTILE_COUNT];
+	static uint8 StepSlots[MAX_CHUNK_PROJECTILE_COUNT];
+
+	const FProjectileSimParams* Config = Params.Config;
+	float StepDt = Params.StepDt;
+	FVector3f Acc = Params.ConstantAcc;
+
+	// start a new segment for every projectile that reached the end of its last one
+	uint32 SegmentCount = 0;
+	for (uint32 I = 0; I < ProjCount; ++I)
+	{
+		if (Step < SegmentEnds[I] || (SkipBits && (SkipBits[I >> 5] & (1u << (I & 31)))))
+		{
+			continue;
+		}
+
+		// a constant acceleration arc bends at most a*t^2/8 away from its chord, only the part of
+		// the acceleration across the velocity bends it. homing turns a tangent away by v*w*t^2/2
+		const FProjectileState& State = Chunk->States[I];
+		float Speed = State.Velocity.Size();
+		FVector3f Dir = Speed > UE_KINDA_SMALL_NUMBER ? State.Velocity / Speed : FVector3f::ZeroVector;
+		float BendAcc = (Acc - Dir * FVector3f::DotProduct(Acc, Dir)).Size() * 0.125f;
+		if (Config->bHoming)
+		{
+			BendAcc += Speed * Config->TurnRate * 0.5f;
+		}
+
+		uint32 StepsLeft = SubstepCount - Step;
+		uint32 SegmentSteps = StepsLeft;
+		if (BendAcc > UE_KINDA_SMALL_NUMBER)
+		{
+			float SegmentTime = FMath::Sqrt(Config->TraceErrorTolerance / BendAcc);
+			SegmentSteps = FMath::Clamp<uint32>((uint32)(SegmentTime / StepDt), 1, StepsLeft);
+		}
+
+		SegmentEnds[I] = (uint8)(Step + SegmentSteps);
+		ClearBits[I >> 5] &= ~(1u << (I & 31));
+
+		if (SegmentSteps > 1)
+		{
+			// where the steps end up, a constant acceleration arc since drag and speed clamping never get here
+			float T = StepDt * (float)SegmentSteps;
+			SegmentStarts[SegmentCount] = State.Position;
+			SegmentEndPoints[SegmentCount] = State.Position + FVector(State.Velocity * T + Acc * (0.5f * T * T));
+			SegmentSlots[SegmentCount++] = (uint8)I;
+		}
+	}
+
+	World.TraceSegments(SegmentStarts, SegmentEndPoints, SegmentCount, SegmentHits);
+	Stats.SegmentTraces += SegmentCount;
+
+	for (uint32 S = 0; S < SegmentCount; ++S)
+	{
+		if (!SegmentHits[S].bBlockingHit && !SegmentHits[S].bStartPenetrating)
+		{
+			uint32 I = SegmentSlots[S];
+			ClearBits[I >> 5] |= 1u << (I & 31);
+		}
+	}
+
+	// steps of a clear segment can't hit anything, the rest is traced like usual
+	uint32 StepCount = 0;
+	uint32 SkipCount = 0;
+	for (uint32 I = 0; I < ProjCount; ++I)
+	{
+		if (SkipBits && (SkipBits[I >> 5] & (1u << (I & 31))))
+		{
+			FProjectileHit& Hit = Hits[I];
+			Hit = {};
+			Hit.Time = 1.0f;
+			++SkipCount;
+		}
+		else if (ClearBits[I >> 5] & (1u << (I & 31)))
+		{
+			FProjectileHit& Hit = Hits[I];
+			Hit = {};
+			Hit.Time = 1.0f;
+		}
+		else
+		{
+			TraceStarts[StepCount] = Chunk->States[I].Position;
+			TraceEnds[StepCount] = Chunk->States[I].Position + FVector(MoveDeltas[I]);
+			StepSlots[StepCount++] = (uint8)I;
+		}
+	}
+
+	World.TraceSegments(TraceStarts, TraceEnds, StepCount, SegmentHits);
+	Stats.Traces += StepCount;
+	Stats.StepTracesAvoided += ProjCount - StepCount - SkipCount;
+
+	for (uint32 S = 0; S < StepCount; ++S)
+	{
+		Hits[StepSlots[S]] = SegmentHits[S];
+	}
+}
+
+/**
+ * stage 2 for configs with a lookahead: static geometry is traced far ahead once and the free distance
+ * cached, following steps only trace dynamic objects until the projectile used that distance up
+ * or drifted off the cached trace (gravity, ricochets, homing).
+ * slots in SkipBits (can be null) are neither traced nor hit anything
+ */
+static void TraceChunkWithLookahead(FProjectileChunk* Chunk, uint32 ProjCount, const FProjectileSimParams* Config,
+	const uint32* SkipBits, const FVector3f* MoveDeltas, IProjectileCollisionWorld& World, FVector* TraceStarts, FVector* TraceEnds,
+	FProjectileHit* Hits, FProjectileSimStats& Stats)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(TraceChunkWithLookahead);
+
+	static uint8 RefreshSlots[MAX_CHUNK_PROJECTILE_COUNT];
+	static float RefreshLengths[MAX_CHUNK_PROJECTILE_COUNT];
+	static FVector RefreshStarts[MAX_CHUNK_PROJECTILE_COUNT];
+	static FVector RefreshEnds[MAX_CHUNK_PROJECTILE_COUNT];
+	static FProjectileHit RefreshHits[MAX_CHUNK_PROJECTILE_COUNT];
+	static uint8 DynamicSlots[MAX_CHUNK_PROJECTILE_COUNT];
+
+	uint32 RefreshCount = 0;
+	uint32 DynamicCount = 0;
+	float ToleranceSq = FMath::Square(Config->LookaheadTolerance);
+
+	for (uint32 I = 0; I < ProjCount; ++I)
+	{
+		if (SkipBits && (SkipBits[I >> 5] & (1u << (I & 31))))
+		{
+			continue;
+		}
+
+		FVector Start = Chunk->States[I].Position;
+		FVector3f Delta = MoveDeltas[I];
+		FVector End = Start + FVector(Delta);
+
+		TraceStarts[DynamicCount] = Start;
+		TraceEnds[DynamicCount] = End;
+		DynamicSlots[DynamicCount++] = (uint8)I;
+
+		// is the end of this step still on the free part of the cached trace
+		FProjectileLookahead& Lookahead = Chunk->Lookaheads[I];
+		FVector3f ToEnd = FVector3f(End - Lookahead.Origin);
+		float Along = FVector3f::DotProduct(ToEnd, Lookahead.Dir);
+		float OffSq = (ToEnd - Lookahead.Dir * Along).SizeSquared();
+
+		if (Along < 0.0f || Along > Lookahead.FreeDistance || OffSq > ToleranceSq)
+		{
+			// never shorter than the step itself, or the step wouldn't be fully covered
+			float StepLength = Delta.Size();
+			float Length = FMath::Max(Config->LookaheadDistance, StepLength);
+			FVector3f Dir = Delta.GetSafeNormal();
+
+			Lookahead.Origin = Start;
+			Lookahead.Dir = Dir;
+
+			RefreshStarts[RefreshCount] = Start;
+			RefreshEnds[RefreshCount] = Start + FVector(Dir * Length);
+			RefreshLengths[RefreshCount] = Length;
+			RefreshSlots[RefreshCount++] = (uint8)I;
+		}
+	}
+
+	Stats.StaticTraces += RefreshCount;
+	Stats.StaticTracesAvoided += DynamicCount - RefreshCount;
+	Stats.DynamicTraces += DynamicCount;
+
+	World.TraceSegments(RefreshStarts, RefreshEnds, RefreshCount, RefreshHits, EProjectileTraceType::Static);
+	World.TraceSegments(TraceStarts, TraceEnds, DynamicCount, Hits, EProjectileTraceType::Dynamic);
+
+	if (DynamicCount < ProjCount)
+	{
+		ScatterSkippedHits(Hits, DynamicSlots, DynamicCount, ProjCount, SkipBits);
+	}
+
+	for (uint32 R = 0; R < RefreshCount; ++R)
+	{
+		uint32 I = RefreshSlots[R];
+		const FProjectileHit& StaticHit = RefreshHits[R];
+
+		float FreeDistance = StaticHit.Time * RefreshLengths[R];
+		Chunk->Lookaheads[I].FreeDistance = FreeDistance;
+
+		// the lookahead is along the step, so a static hit inside the step maps straight onto it
+		if (StaticHit.bBlockingHit || StaticHit.bStartPenetrating)
+		{
+			float StepLength = MoveDeltas[I].Size();
+			float Time = StepLength > UE_SMALL_NUMBER ? FreeDistance / StepLength : 0.0f;
+
+			if (Time <= 1.0f && (Time < Hits[I].Time || !(Hits[I].bBlockingHit || Hits[I].bStartPenetrating)))
+			{
+				Hits[I] = StaticHit;
+				Hits[I].Time = Time;
+			}
+		}
+	}
+}
+
+/** the projectiles in [First, Last) are in unloaded streaming cells, does what their config's UnloadedPolicy says */
+static void SimulateUnloaded(FProjectileChunk* Chunk, uint32 First, uint32 Last, const FProjectileStepParams& Params,
+	float DeltaTime, bool bKeepPrevPositions, TArray<FProjectileKill>& Kills, FProjectileSimStats& Stats)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(SimulateUnloaded);
+
+	uint32 Count = Last - First;
+
+	switch (Params.Config->UnloadedPolicy)
+	{
+	case EProjectileUnloadedPolicy::Freeze:
+		Stats.Frozen += Count;
+		break;
+
+	case EProjectileUnloadedPolicy::Ballistic:
+		// one step for the whole tick, no drag and no traces. nothing is loaded to hit,
+		// it only has to be roughly where it should be once the cell loads
+		for (uint32 I = First; I < Last; ++I)
+		{
+			FProjectileState* State = Chunk->States + I;
+
+			if (bKeepPrevPositions)
+			{
+				Chunk->PrevPositions[I] = State->Position;
+			}
+
+			State->Velocity += Params.ConstantAcc * DeltaTime;
+			if (Params.MaxSpeed > 0.0f)
+			{
+				State->Velocity = State->Velocity.GetClampedToMaxSize(Params.MaxSpeed);
+			}
+
+			State->Position += FVector(State->Velocity * DeltaTime);
+			State->Lifetime += DeltaTime;
+
+			if (Params.Config->bRotationFollowsVelocity)
+			{
+				State->Rotation = State->Velocity.Rotation();
+			}
+
+			if (Params.MaxLifetime > 0.0f && State->Lifetime >= Params.MaxLifetime)
+			{
+				Kills.Add({ Chunk->Handles[I], EProjectileDestroyReason::Lifetime, State->Position });
+			}
+		}
+
+		Stats.Ballistic += Count;
+		break;
+
+	case EProjectileUnloadedPolicy::Expire:
+		for (uint32 I = First; I < Last; ++I)
+		{
+			Kills.Add({ Chunk->Handles[I], EProjectileDestroyReason::Unloaded, Chunk->States[I].Position });
+		}
+
+		Stats.Expired += Count;
+		break;
+
+	default:
+		// Simulate never gets partitioned out
+		checkNoEntry();
+		break;
+	}
+}
+
+/** a kernel specialized for one combination of EProjectileKernelFeature */
+struct FProjectileKernel
+{
+	void (*Integrate)(FProjectileChunk*, uint32, const FProjectileStepParams&, FVector3f*);
+	uint32 (*Finalize)(FProjectileChunk*, uint32, const FProjectileStepParams&, const FVector3f*,
+		const FProjectileHit*, IProjectileCollisionWorld&, uint8*, EProjectileDestroyReason*);
+};
+
+template<uint32... FeatureMasks>
+static const FProjectileKernel* MakeKernelTable(TIntegerSequence<uint32, FeatureMasks...>)
+{
+	// instantiates every combination once, indexed by the feature mask
+	static const FProjectileKernel Table[] = { { &IntegrateChunk<FeatureMasks>, &FinalizeChunk<FeatureMasks> }... };
+	return Table;
+}
+
+static const FProjectileKernel& GetProjectileKernel(uint32 Features)
+{
+	static const FProjectileKernel* Table = MakeKernelTable(TMakeIntegerSequence<uint32, PKF_Combinations>());
+	check(Features < PKF_Combinations);
+	return Table[Features];
+}
+
+void FProjectileSimulation::Tick(float DeltaTime, float GravityZ, IProjectileCollisionWorld& World)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::Tick);
+
+	BeginTick(DeltaTime, GravityZ, World);
+	SimulateTick();
+	EndTick();
+}
+
+void FProjectileSimulation::BeginTick(float DeltaTime, float GravityZ, IProjectileCollisionWorld& World)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::BeginTick);
+
+	check(!bTickInFlight);
+
+	Stats = {};
+	Stats.Rejected = RejectedSinceTick;
+	RejectedSinceTick = 0;
+
+	// number of update iterations we need to run
+	uint32 SubstepCount;
+	float StepDt;
+
+	if (bDeterministic)
+	{
+		FlushPendingDestroys();
+
+		// run whole fixed steps only and carry the remainder over to the next frame.
+		// if we fall too far behind we drop the time instead of spiraling,
+		// the simulation stays deterministic since it only ever sees FixedTimestep
+		TimeAccumulator += DeltaTime;
+		SubstepCount = (uint32)FMath::FloorToInt(TimeAccumulator / FixedTimestep);
+		SubstepCount = FMath::Min<uint32>(SubstepCount, MAX_PROJECTILE_SUBSTEP);
+		TimeAccumulator = FMath::Min(TimeAccumulator - FixedTimestep * (float)SubstepCount, FixedTimestep);
+		StepDt = FixedTimestep;
+	}
+	else
+	{
+		SubstepCount = (uint32)FMath::CeilToInt(DeltaTime / MAX_PROJECTILE_TIMESTEP);
+		SubstepCount = FMath::Min<uint32>(SubstepCount, MAX_PROJECTILE_SUBSTEP);
+		StepDt = DeltaTime / (float)SubstepCount;
+	}
+
+	// make room for next frame's spawns, before the tick takes the chunks
+	EvictForHeadroom();
+
+	TickSubstepCount = SubstepCount;
+	TickStepDt = StepDt;
+	TickGravityZ = GravityZ;
+	TickWorld = &World;
+	TickConfigs.Reset();
+	TickConfigs.Append(Configs);
+	TickTargets = Targets;
+
+	TickDebugLinesLeft.SetNumUninitialized(Configs.Num());
+	for (int32 ConfigId = 0; ConfigId < Configs.Num(); ++ConfigId)
+	{
+		uint32 MaxDebugLines = Configs[ConfigId].MaxDebugLines;
+		TickDebugLinesLeft[ConfigId] = MaxDebugLines > 0 ? MaxDebugLines : MAX_uint32;
+	}
+
+	// everything that exists right now is owned by the tick until EndTick.
+	// projectiles created after this go at the end of the chunks and wait for the next tick
+	TickChunkCount = (uint32)Chunks.Num();
+	for (uint32 ChunkIndex = 0; ChunkIndex < TickChunkCount; ++ChunkIndex)
+	{
+		FProjectileChunk* Chunk = &Chunks[ChunkIndex];
+
+		// this prevents dangerous functions like Destroy Projectile from being called while
+		// we are updating the projectiles
+		Chunk->bInsideTick = true;
+		Chunk->TickCount = Chunk->Count;
+		Chunk->TickActiveCount = Chunk->Count;
+
+		// the game decided which cells aren't loaded, the kernels only run on the rest
+		if (UnloadedCells.Num() > 0 && Configs[Chunk->ConfigId].UnloadedPolicy != EProjectileUnloadedPolicy::Simulate)
+		{
+			PartitionUnloaded(ChunkIndex);
+		}
+	}
+
+	TickOccupiedCells.Reset();
+
+	bTickInFlight = true;
+}
+
+void FProjectileSimulation::SimulateTick()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::SimulateTick);
+
+	check(bTickInFlight);
+
+	IProjectileCollisionWorld& World = *TickWorld;
+
+	if (TickTargets.Num() > 1)
+	{
+		AcquireTargets();
+	}
+
+	for (uint32 ChunkIndex = 0; ChunkIndex < TickChunkCount; ++ChunkIndex)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(TickProjectileChunk);
+
+		FProjectileChunk* Chunk = &Chunks[ChunkIndex];
+		const FProjectileSimParams* Config = &TickConfigs[Chunk->ConfigId];
+
+		// pick the kernel that only does the math this config needs
+		const FProjectileKernel& Kernel = GetProjectileKernel(Config->GetKernelFeatures(TickGravityZ));
+
+		FProjectileStepParams Params;
+		Params.StepDt = TickStepDt;
+		Params.ConstantAcc = FVector3f(0.0f, 0.0f, TickGravityZ * Config->GravityScale) + Config->Wind;
+		Params.MaxSpeed = Config->MaxSpeed;
+		Params.DragCoefficient = Config->DragCoefficient;
+		Params.MaxLifetime = Config->MaxLifetime;
+		Params.bDebugDraw = Config->bDebugDraw;
+		Params.DebugLinesLeft = &TickDebugLinesLeft[Chunk->ConfigId];
+		Params.SkipBits = nullptr;
+		Params.bResolveHits = Config->MaxBounces > 0 || Config->MaxPenetrations > 0;
+		Params.MaxTurnAngle = Config->TurnRate * TickStepDt;
+		Params.Targets = TickTargets.GetData();
+		Params.Config = Config;
+		
+		// projectile that should be destroyed this frame
+		// it's not safe to destroy projectiles while we are updating them so it needs to be deferred
+		// we also don't want to trash the cpu cache with destruction
+		static uint8 DestroySlots[MAX_CHUNK_PROJECTILE_COUNT];
+		static EProjectileDestroyReason DestroyReasons[MAX_CHUNK_PROJECTILE_COUNT];
+
+		// input & output to the second stage
+		static FVector3f MoveDeltas[MAX_CHUNK_PROJECTILE_COUNT];
+		static FVector TraceStarts[MAX_CHUNK_PROJECTILE_COUNT];
+		static FVector TraceEnds[MAX_CHUNK_PROJECTILE_COUNT];
+		static FProjectileHit Hits[MAX_CHUNK_PROJECTILE_COUNT];
+		static uint8 TraceSlots[MAX_CHUNK_PROJECTILE_COUNT];
+
+		// killed projectiles stay in their slot until EndTick, later substeps don't move or trace them
+		uint32 KilledBits[MAX_CHUNK_PROJECTILE_BITMAP32_COUNT] = {};
+		uint32 KilledCount = 0;
+
+		// segments of the adaptive traces, every projectile starts a new one on the first substep
+		uint8 SegmentEnds[MAX_CHUNK_PROJECTILE_COUNT] = {};
+		uint32 SegmentClearBits[MAX_CHUNK_PROJECTILE_BITMAP32_COUNT] = {};
+
+		// projectiles in unloaded cells are at the end, see PartitionUnloaded
+		uint32 ProjCount = Chunk->TickActiveCount;
+		Stats.Simulated += ProjCount;
+
+		for (uint32 Step = 0; Step < TickSubstepCount; ++Step)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(Substep);
+
+			// projectile are updated in 3 stages:
+			// 1. compute the MoveDelta to use for the sweep stage
+			// 2. perform hit sweeps
+			// 3. handle hit result and compute final velocity
+
+			// where the snapshot interpolates from
+			if (bPublishSnapshots)
+			{
+				for (uint32 I = 0; I < ProjCount; ++I)
+				{
+					Chunk->PrevPositions[I] = Chunk->States[I].Position;
+				}
+			}
+
+			Kernel.Integrate(Chunk, ProjCount, Params, MoveDeltas);
+
+			// the killed ones stay where they died
+			const uint32* SkipBits = KilledCount > 0 ? KilledBits : nullptr;
+			if (SkipBits)
+			{
+				for (uint32 I = 0; I < ProjCount; ++I)
+				{
+					if (SkipBits[I >> 5] & (1u << (I & 31)))
+					{
+						MoveDeltas[I] = FVector3f::ZeroVector;
+					}
+				}
+			}
+
+			if (Config->LookaheadDistance > 0.0f)
+			{
+				TraceChunkWithLookahead(Chunk, ProjCount, Config, SkipBits, MoveDeltas, World, TraceStarts, TraceEnds, Hits, Stats);
+			}
+			else if (Config->TraceErrorTolerance > 0.0f && Config->DragCoefficient <= 0.0f && Config->MaxSpeed <= 0.0f
+				&& TickSubstepCount > 1)
+			{
+				// only with a constant acceleration, the chord error bound doesn't hold with drag or speed clamping
+				TraceChunkAdaptive(Chunk, ProjCount, Params, Step, TickSubstepCount, SegmentEnds, SegmentClearBits,
+					SkipBits, MoveDeltas, World, TraceStarts, TraceEnds, Hits, Stats);
+			}
+			else
+			{
+				uint32 TraceCount = 0;
+				for (uint32 I = 0; I < ProjCount; ++I)
+				{
+					if (SkipBits && (SkipBits[I >> 5] & (1u << (I & 31))))
+					{
+						continue;
+					}
+
+					FProjectileState* State = Chunk->States + I;
+
+					TraceStarts[TraceCount] = State->Position;
+					TraceEnds[TraceCount] = State->Position + FVector(MoveDeltas[I]);
+					TraceSlots[TraceCount++] = (uint8)I;
+				}
+
+				World.TraceSegments(TraceStarts, TraceEnds, TraceCount, Hits);
+				Stats.Traces += TraceCount;
+
+				if (TraceCount < ProjCount)
+				{
+					ScatterSkippedHits(Hits, TraceSlots, TraceCount, ProjCount, SkipBits);
+				}
+			}
+
+			Params.SkipBits = SkipBits;
+			uint32 DestroyCount = Kernel.Finalize(Chunk, ProjCount, Params, MoveDeltas, Hits, World,
+				DestroySlots, DestroyReasons);
+
+			for (uint32 I = 0; I < DestroyCount; ++I)
+			{
+				uint32 Slot = DestroySlots[I];
+				uint32 Bit = 1u << (Slot & 31);
+				if ((KilledBits[Slot >> 5] & Bit) == 0)
+				{
+					KilledBits[Slot >> 5] |= Bit;
+					++KilledCount;
+					Kills.Add({ Chunk->Handles[Slot], DestroyReasons[I], Chunk->States[Slot].Position });
+				}
+			}
+		}
+
+		if (ProjCount < Chunk->TickCount)
+		{
+			SimulateUnloaded(Chunk, ProjCount, Chunk->TickCount, Params, TickStepDt * (float)TickSubstepCount,
+				bPublishSnapshots, Kills, Stats);
+		}
+
+		FBox Bounds(ForceInit);
+		for (uint32 I = 0; I < Chunk->TickCount; ++I)
+		{
+			Bounds += Chunk->States[I].Position;
+		}
+
+		Chunk->TickBounds = Bounds;
+
+		// the game checks these cells against streaming before the next tick. chunks are sorted
+		// along a morton curve, so neighbours mostly share a cell and the set is rarely touched
+		if (StreamingCellSize > 0.0f && Chunk->TickCount > 0)
+		{
+			FIntPoint LastCell = GetStreamingCell(Chunk->States[0].Position);
+			TickOccupiedCells.Add(LastCell);
+
+			for (uint32 I = 1; I < Chunk->TickCount; ++I)
+			{
+				FIntPoint Cell = GetStreamingCell(Chunk->States[I].Position);
+				if (Cell != LastCell)
+				{
+					TickOccupiedCells.Add(Cell);
+					LastCell = Cell;
+				}
+			}
+		}
+	}
+}
+
+void FProjectileSimulation::AcquireTargets()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::AcquireTargets);
+
+	// searching every target for every projectile every frame doesn't scale to swarms.
+	// instead each chunk gathers the few targets near it once, and only a budget of projectiles
+	// per frame pick a new target from those, round-robin so everyone gets a turn
+	uint32 Budget = MaxRetargetsPerFrame;
+	uint32 TargetCount = (uint32)TickTargets.Num();
+
+	// rotate which chunk goes first so the budget doesn't always run out on the same chunks
+	uint32 FirstChunk = TickChunkCount > 0 ? RetargetChunkCursor++ % TickChunkCount : 0;
+
+	for (uint32 N = 0; N < TickChunkCount && Budget > 0; ++N)
+	{
+		FProjectileChunk* Chunk = &Chunks[(FirstChunk + N) % TickChunkCount];
+		const FProjectileSimParams* Config = &TickConfigs[Chunk->ConfigId];
+
+		uint32 ProjCount = Chunk->TickActiveCount;
+		if (!Config->bHoming || ProjCount == 0)
+		{
+			continue;
+		}
+
+		// bounds of the chunk grown by the acquisition range, anything outside can't be acquired by anyone
+		FBox Bounds(ForceInit);
+		for (uint32 I = 0; I < ProjCount; ++I)
+		{
+			Bounds += Chunk->States[I].Position;
+		}
+		Bounds = Bounds.ExpandBy(Config->AcquisitionRange);
+
+		static FVector CandidateLocations[MAX_CHUNK_TARGET_CANDIDATES];
+		static uint16 CandidateIds[MAX_CHUNK_TARGET_CANDIDATES];
+		uint32 CandidateCount = 0;
+
+		for (uint32 TargetId = 1; TargetId < TargetCount && CandidateCount < MAX_CHUNK_TARGET_CANDIDATES; ++TargetId)
+		{
+			const FProjectileTarget& Target = TickTargets[TargetId];
+			if (Target.bValid && Bounds.IsInsideOrOn(Target.Location))
+			{
+				CandidateLocations[CandidateCount] = Target.Location;
+				CandidateIds[CandidateCount++] = (uint16)TargetId;
+			}
+		}
+
+		uint32 RetargetCount = FMath::Min(Budget, ProjCount);
+		Budget -= RetargetCount;
+
+		float RangeSq = FMath::Square(Config->AcquisitionRange);
+
+		for (uint32 R = 0; R < RetargetCount; ++R)
+		{
+			uint32 I = Chunk->RetargetCursor++ % ProjCount;
+			const FProjectileState* State = Chunk->States + I;
+			FVector3f Dir = State->Velocity.GetSafeNormal();
+
+			// the target closest to where we are heading, inside the cone and range
+			uint16 BestId = 0;
+			float BestCos = Config->AcquisitionCosHalfAngle;
+
+			for (uint32 C = 0; C < CandidateCount; ++C)
+			{
+				FVector3f ToTarget = FVector3f(CandidateLocations[C] - State->Position);
+				float DistSq = ToTarget.SizeSquared();
+				if (DistSq > RangeSq || DistSq < UE_SMALL_NUMBER)
+				{
+					continue;
+				}
+
+				float Cos = FVector3f::DotProduct(Dir, ToTarget * FMath::InvSqrt(DistSq));
+				if (Cos >= BestCos)
+				{
+					BestCos = Cos;
+					BestId = CandidateIds[C];
+				}
+			}
+
+			Chunk->TargetIds[I] = BestId;
+		}
+	}
+}
+
+void FProjectileSimulation::EvictForHeadroom()
+{
+	uint32 FreeCount = HandleTable.GetFreeCount();
+	if (FreeCount >= SaturationHeadroom)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::EvictForHeadroom);
+
+	// everything that may be evicted. configs of the same priority with different
+	// policies are ordered by their own measure, it's up to the configs to not mix them
+	EvictionCandidates.Reset();
+	for (const FProjectileChunk& Chunk : Chunks)
+	{
+		const FProjectileSimParams& Config = Configs[Chunk.ConfigId];
+		if (Config.SaturationPolicy == EProjectileSaturationPolicy::Reject || Config.Priority >= ReservedPriority)
+		{
+			continue;
+		}
+
+		bool bFarthest = Config.SaturationPolicy == EProjectileSaturationPolicy::EvictFarthest && EvictionFocus.Num() > 0;
+
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			float Score = Chunk.States[I].Lifetime;
+			if (bFarthest)
+			{
+				double MinDistSq = TNumericLimits<double>::Max();
+				for (const FVector& Focus : EvictionFocus)
+				{
+					MinDistSq = FMath::Min(MinDistSq, FVector::DistSquared(Focus, Chunk.States[I].Position));
+				}
+				Score = (float)MinDistSq;
+			}
+
+			EvictionCandidates.Add({ Chunk.Handles[I], Config.Priority, Score });
+		}
+	}
+
+	// lowest priority first, then the highest score. the handle index breaks ties so deterministic runs agree
+	auto EvictsBefore = [](const FProjectileEvictionCandidate& A, const FProjectileEvictionCandidate& B)
+	{
+		if (A.Priority != B.Priority)
+		{
+			return A.Priority < B.Priority;
+		}
+		if (A.Score != B.Score)
+		{
+			return A.Score > B.Score;
+		}
+		return A.Handle.Index < B.Handle.Index;
+	};
+
+	// only the first few are needed, a heap avoids sorting everything
+	uint32 EvictCount = FMath::Min(SaturationHeadroom - FreeCount, (uint32)EvictionCandidates.Num());
+	EvictionCandidates.Heapify(EvictsBefore);
+
+	for (uint32 I = 0; I < EvictCount; ++I)
+	{
+		FProjectileEvictionCandidate Candidate;
+		EvictionCandidates.HeapPop(Candidate, EvictsBefore, false);
+		DestroyProjectileImmediate(Candidate.Handle, EProjectileDestroyReason::Evicted);
+	}
+
+	Stats.Evicted += EvictCount;
+}
+
+void FProjectileSimulation::EndTick()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSimulation::EndTick);
+
+	check(bTickInFlight);
+	bTickInFlight = false;
+
+	// after we are done with the updating we can destroy the projectiles
+	for (uint32 ChunkIndex = 0; ChunkIndex < TickChunkCount; ++ChunkIndex)
+	{
+		FProjectileChunk* Chunk = &Chunks[ChunkIndex];
+		Chunk->bInsideTick = false;
+
+		// plus whatever spawned while the tick was in flight
+		Chunk->Bounds = Chunk->TickBounds;
+		for (uint32 I = Chunk->TickCount; I < Chunk->Count; ++I)
+		{
+			Chunk->Bounds += Chunk->States[I].Position;
+		}
+	}
+
+	// kills come out in chunk and slot order which is already deterministic,
+	// so they skip the deferred path in deterministic mode as well
+	for (const FProjectileKill& Kill : Kills)
+	{
+		DestroyProjectileImmediate(Kill.Handle, Kill.Reason, &Kill.Location);
+	}
+
+	Kills.Reset();
+	TickWorld = nullptr;
+
+	// a few chunks per tick, every chunk gets its turn eventually
+	uint32 ChunkCount = (uint32)Chunks.Num();
+	uint32 SortCount = FMath::Min(MaxChunkSortsPerFrame, ChunkCount);
+	for (uint32 I = 0; I < SortCount; ++I)
+	{
+		SortChunk(SortChunkCursor++ % ChunkCount);
+	}
+
+	TRACE_COUNTER_SET(ProjectileTraces, Stats.Traces);
+	TRACE_COUNTER_SET(ProjectileStaticTraces, Stats.StaticTraces);
+	TRACE_COUNTER_SET(ProjectileDynamicTraces, Stats.DynamicTraces);
+	TRACE_COUNTER_SET(ProjectileStaticTracesAvoided, Stats.StaticTracesAvoided);
+	TRACE_COUNTER_SET(ProjectileSegmentTraces, Stats.SegmentTraces);
+	TRACE_COUNTER_SET(ProjectileStepTracesAvoided, Stats.StepTracesAvoided);
+	TRACE_COUNTER_SET(ProjectileSimulated, Stats.Simulated);
+	TRACE_COUNTER_SET(ProjectileFrozen, Stats.Frozen);
+	TRACE_COUNTER_SET(ProjectileBallistic, Stats.Ballistic);
+	TRACE_COUNTER_SET(ProjectileExpired, Stats.Expired);
+	TRACE_COUNTER_SET(ProjectileRejected, Stats.Rejected);
+	TRACE_COUNTER_SET(ProjectileEvicted, Stats.Evicted);
+
+	// hand the cells of this tick to the game
+	Swap(OccupiedCells, TickOccupiedCells);
+
+	// everything moved
+	bSpatialIndexDirty = true;
+
+	if (bPublishSnapshots)
+	{
+		// the game clock is TimeAccumulator past the last fixed step, without fixed steps it's right on it
+		float Alpha = bDeterministic ? FMath::Clamp(TimeAccumulator / FixedTimestep, 0.0f, 1.0f) : 1.0f;
+		Snapshots.Publish(Chunks.GetData(), (uint32)Chunks.Num(), TickStepDt, Alpha);
+	}
+
+	if (bDeterministic)
+	{
+		if (TickSubstepCount > 0)
+		{
+			StepNumber += TickSubstepCount;
+			StateHash = ComputeStateHash();
+		}
+	}
+	else
+	{
+		// explicit destroys that came in while the tick was in flight
+		FlushPendingDestroys();
+	}
+}
@@ -0,0 +1,425 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProjectileHandle.h"
+#include "ProjectileSpatialIndex.h"
+#include "ProjectileSnapshot.h"
+#include "ProjectileExplosion.h"
+
+// NOTE: this file is engine agnostic, it must only ever depend on Core.
+// everything the simulation needs from the world goes through IProjectileCollisionWorld
+
+// max number of projectiles. hard limited by 16-bits, the last index is reserved for FProjectileHandle::Invalid
+#define MAX_PROJECTILE_HANDLES (16384)
+// max number of unique chunks. hard limited by 8-bits
+#define MAX_CHUNK_COUNT (256)
+// max number of projectiles that fit inside a single chunk. hard limited by 8-bits
+#define MAX_CHUNK_PROJECTILE_COUNT (256)
+// number of 32-bit values needed to create a bitmap with 1 bit for each MAX_CHUNK_PROJECTILE_COUNT
+#define MAX_CHUNK_PROJECTILE_BITMAP32_COUNT ((MAX_CHUNK_PROJECTILE_COUNT + 31) / 32)
+
+static_assert(MAX_PROJECTILE_HANDLES <= TNumericLimits<uint16>::Max());
+static_assert(MAX_CHUNK_COUNT <= TNumericLimits<uint8>::Max() + 1);
+static_assert(MAX_CHUNK_PROJECTILE_COUNT <= TNumericLimits<uint8>::Max() + 1);
+
+// maximum frame delta allowed before we need to substep
+#define MAX_PROJECTILE_TIMESTEP (1.0f / 20.0f)
+// maximum number of substep iterations before continuing
+#define MAX_PROJECTILE_SUBSTEP (4)
+
+static_assert(MAX_PROJECTILE_SUBSTEP > 0);
+static_assert(MAX_PROJECTILE_TIMESTEP > 0.0f);
+
+// maximum number of extra traces a projectile can do per substep to continue after a ricochet/penetration
+#define MAX_PROJECTILE_RETRACES (2)
+// number of physical surface types a penetration depth can be configured for. matches SurfaceType_Max
+#define MAX_PROJECTILE_SURFACE_TYPES (64)
+
+// max number of homing targets. target ids are 16-bits, 0 is reserved for "no target"
+#define MAX_PROJECTILE_TARGETS (4096)
+// max number of targets a chunk considers when its projectiles look for a new target
+#define MAX_CHUNK_TARGET_CANDIDATES (64)
+
+static_assert(MAX_PROJECTILE_TARGETS <= TNumericLimits<uint16>::Max() + 1);
+
+/**
+ * Optional terms of the projectile update. Every chunk runs a kernel that is compiled
+ * for exactly the features its config uses, so unused terms cost nothing
+ */
+enum EProjectileKernelFeature : uint32
+{
+	PKF_Gravity			= 1 << 0,	// world gravity scaled by GravityScale
+	PKF_Drag			= 1 << 1,	// quadratic air drag
+	PKF_Wind			= 1 << 2,	// constant wind acceleration
+	PKF_MaxSpeed		= 1 << 3,	// clamp velocity to MaxSpeed
+	PKF_Rotation		= 1 << 4,	// rotation follows velocity
+	PKF_Lifetime		= 1 << 5,	// destroy after MaxLifetime
+	PKF_Homing			= 1 << 6,	// steer towards the acquired target
+
+	PKF_Count			= 7,
+	PKF_Combinations	= 1 << PKF_Count,
+};
+
+/** What projectiles in a streaming cell that isn't loaded do, there is no geometry to trace against */
+enum class EProjectileUnloadedPolicy : uint8
+{
+	Simulate,		// keep simulating as usual, misses everything that isn't loaded
+	Freeze,			// stay where they are, lifetime included, until the cell loads
+	Ballistic,		// move without tracing, until the cell loads
+	Expire,			// destroyed with EProjectileDestroyReason::Unloaded
+};
+
+/** What happens to projectiles below FProjectileSimulation::ReservedPriority once the simulation runs out of headroom.
+	Their spawns are rejected either way, until there is headroom again */
+enum class EProjectileSaturationPolicy : uint8
+{
+	Reject,			// the ones in flight keep flying
+	EvictOldest,	// the ones in flight are destroyed to restore the headroom, oldest first
+	EvictFarthest,	// the same but farthest from FProjectileSimulation::EvictionFocus first
+};
+
+/** Simulation parameters shared by all projectiles of one type */
+struct PROJECTILECORE_API FProjectileSimParams
+{
+	float				InitialSpeed;
+	float				MaxSpeed;						// <= 0 is unclamped
+	float				MaxLifetime;					// 0 lives forever
+	float				GravityScale;					// multiplier for world gravity
+	float				DragCoefficient;				// a = -DragCoefficient * |v| * v
+	FVector3f			Wind;							// constant acceleration
+	uint8				MaxBounces;						// ricochets before the next hit destroys the projectile
+	uint8				MaxPenetrations;				// surfaces it can go through before the next hit destroys it
+	float				Restitution;					// normal velocity kept when bouncing
+	float				BounceFriction;					// tangential velocity lost when bouncing
+	float				MinBounceSpeed;					// slower projectiles are destroyed instead of bouncing
+	float				PenetrationSpeedRetention;		// velocity kept after going through a surface
+	float				PenetrationDepth[MAX_PROJECTILE_SURFACE_TYPES];	// max thickness it can go through per surface type
+	float				TurnRate;						// max radians per second a homing projectile turns
+	float				AcquisitionCosHalfAngle;		// cosine of the cone half angle targets are acquired in
+	float				AcquisitionRange;				// max distance targets are acquired at
+	float				LookaheadDistance;				// length of the cached static trace, 0 traces everything every step
+	float				LookaheadTolerance;				// how far off the cached trace a projectile can drift before re-tracing
+	float				TraceErrorTolerance;			// how far the trajectory can bend away from a trace covering several steps, 0 traces every step. constant acceleration only
+	float				ExplosionRadius;				// explodes when destroyed by a hit, 0 doesn't explode
+	FColor				DebugColor;						// color of the debug lines
+	uint16				DebugSampleRate;				// draw every Nth projectile, 1 draws all of them
+	uint32				MaxDebugLines;					// projectiles drawn per tick, 0 is no limit
+	EProjectileUnloadedPolicy UnloadedPolicy;			// what to do in streaming cells that aren't loaded
+	uint8				Priority;						// lower priorities are rejected and evicted first when saturated
+	EProjectileSaturationPolicy SaturationPolicy;		// what to do when saturated and below ReservedPriority
+	uint8				bHoming:1;						// look for and steer towards registered targets
+	uint8				bRotationFollowsVelocity:1;
+	uint8				bDebugDraw:1;
+
+	/** which EProjectileKernelFeature the kernel for these params needs */
+	uint32 GetKernelFeatures(float GravityZ) const;
+};
+
+/** Per-projectile data which is updated for each simulation step */
+struct PROJECTILECORE_API alignas(PLATFORM_CACHE_LINE_SIZE) FProjectileState
+{
+	FVector				Position;		// world position
+	FRotator3f			Rotation;		// world rotation, float32 is enough
+	FVector3f			Velocity;		// world velocity, float32 is enough
+	float				Lifetime;		// time this projectile has been alive
+	uint8				Bounces;		// ricochets so far
+	uint8				Penetrations;	// surfaces gone through so far
+	// 10 bytes of padding available here
+};
+
+/** Why a projectile was destroyed */
+enum class EProjectileDestroyReason : uint8
+{
+	Hit,			// blocking hit
+	Lifetime,		// exceeded MaxLifetime
+	Explicit,		// DestroyProjectile was called
+	Promoted,		// turned into an actor, see UProjectileSubsystem::PromoteProjectile
+	Unloaded,		// in a streaming cell that isn't loaded, see EProjectileUnloadedPolicy::Expire
+	Evicted,		// made room for higher priority spawns, see EProjectileSaturationPolicy
+};
+
+/** Sent to the owner of a projectile once it has been destroyed */
+struct PROJECTILECORE_API FProjectileDestroyEvent
+{
+	FProjectileHandle			Handle;		// no longer valid, only useful for bookkeeping
+	uint16						OwnerId;	// who to notify, never 0
+	EProjectileDestroyReason	Reason;
+	FVector						Location;	// where the projectile was when destroyed
+};
+
+/** Cached result of a long trace against static geometry, see FProjectileSimParams::LookaheadDistance */
+struct PROJECTILECORE_API FProjectileLookahead
+{
+	FVector				Origin;			// where the lookahead trace started
+	FVector3f			Dir;			// direction of the lookahead trace
+	float				FreeDistance;	// distance along Dir known to be free of static geometry
+};
+
+/** Main data container for projectiles */
+struct PROJECTILECORE_API FProjectileChunk
+{
+	uint16				ConfigId;		// shared config all these projectiles use
+	uint8*				DataPtr;		// pointer to the allocated memory block
+	uint32				DataSize;		// size of the memory block, the same for every chunk
+	FProjectileState*	States;			// per-projectile state
+	FProjectileHandle*	Handles;		// index to the handle for each projectile in the chunk
+	uint16*				OwnerIds;		// who wants to know when the projectile is destroyed, 0 is nobody
+	uint16*				TargetIds;		// what a homing projectile steers towards, 0 is nothing
+	FProjectileLookahead* Lookaheads;	// static geometry known to be free ahead, only used with LookaheadDistance
+	FVector*			PrevPositions;	// position before the last substep, only kept with bPublishSnapshots
+	uint32				Count;			// number of projectiles in this chunk
+	uint32				RetargetCursor;	// next projectile to look for a new target, round-robin
+	FBox				Bounds;			// around every projectile, grows with spawns. new projectiles go to the nearest chunk
+	FBox				TickBounds;		// Bounds computed by the tick in flight, published when it ends
+	uint32				TickCount;		// projectiles simulated by the tick in flight, the rest were created during it
+	uint32				TickActiveCount;	// of TickCount, the ones fully simulated. the rest are in unloaded streaming cells
+	bool				bInsideTick;	// this chunk is being updated (not safe to remove projectiles)
+};
+
+/** Projectile killed by the tick in flight, destroyed once the tick ends */
+struct PROJECTILECORE_API FProjectileKill
+{
+	FProjectileHandle			Handle;
+	EProjectileDestroyReason	Reason;
+	FVector						Location;	// where it was killed, it keeps moving until the tick ends
+};
+
+/** Projectile that can be evicted to make room, see FProjectileSimulation::EvictForHeadroom */
+struct PROJECTILECORE_API FProjectileEvictionCandidate
+{
+	FProjectileHandle	Handle;
+	uint8				Priority;
+	float				Score;			// lifetime or squared distance to the focus, higher goes first
+};
+
+/** Something homing projectiles can lock on to */
+struct PROJECTILECORE_API FProjectileTarget
+{
+	FVector				Location;
+	bool				bValid;			// false for removed targets and for id 0
+};
+
+/**
+ * Compact result of a single segment trace. There is no hit component or actor in here, the simulation can't
+ * know engine types and nothing in it needs one. no trace path resolves one, impact code that needs it traces again
+ */
+struct PROJECTILECORE_API FProjectileHit
+{
+	float				Time;					// [0, 1] along the segment, 1 if nothing was hit
+	FVector3f			Normal;					// surface normal at the impact
+	uint8				SurfaceType;			// physical surface type, selects the penetration depth
+	uint8				bBlockingHit:1;
+	uint8				bStartPenetrating:1;	// the segment started inside geometry
+};
+
+/** What a trace collides with */
+enum class EProjectileTraceType : uint8
+{
+	All,			// everything, the regular per-step trace
+	Static,			// only geometry that doesn't move, safe to cache
+	Dynamic,		// only things that can move
+};
+
+/** Counters for the last tick */
+struct PROJECTILECORE_API FProjectileSimStats
+{
+	uint32				Traces;					// per-step traces against everything
+	uint32				StaticTraces;			// lookahead traces against static geometry
+	uint32				DynamicTraces;			// per-step traces against dynamic objects only
+	uint32				StaticTracesAvoided;	// steps that were covered by a cached lookahead
+	uint32				SegmentTraces;			// traces covering several steps of a nearly straight trajectory
+	uint32				StepTracesAvoided;		// steps that were covered by a segment trace
+	uint32				Simulated;				// projectiles fully simulated
+	uint32				Frozen;					// projectiles in unloaded streaming cells that stood still
+	uint32				Ballistic;				// projectiles in unloaded streaming cells that moved without tracing
+	uint32				Expired;				// projectiles destroyed for being in an unloaded streaming cell
+	uint32				Rejected;				// spawns refused since the previous tick, out of room or headroom
+	uint32				Evicted;				// projectiles destroyed to restore the headroom
+};
+
+/**
+ * Everything the simulation needs to know about the world it runs in.
+ * Implemented on top of UWorld by the game, and by FProjectileStubCollisionWorld for offline use.
+ * Called from whatever thread runs FProjectileSimulation::SimulateTick
+ */
+class PROJECTILECORE_API IProjectileCollisionWorld
+{
+public:
+
+	virtual ~IProjectileCollisionWorld() = default;
+
+	/** traces Count line segments and writes one hit per segment */
+	virtual void TraceSegments(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+		EProjectileTraceType Type = EProjectileTraceType::All) = 0;
+
+	/** traces a single segment, used for the few projectiles that continue after a hit */
+	virtual FProjectileHit TraceSegment(const FVector& Start, const FVector& End,
+		EProjectileTraceType Type = EProjectileTraceType::All)
+	{
+		FProjectileHit Hit;
+		TraceSegments(&Start, &End, 1, &Hit, Type);
+		return Hit;
+	}
+
+	/** visualize a projectile movement segment, only called for configs with bDebugDraw.
+		called from whatever thread runs SimulateTick, expected to be buffered */
+	virtual void DrawDebugLine(const FVector& Start, const FVector& End, const FColor& Color) {}
+};
+
+/**
+ * Creates/Destroys/Updates projectiles stored in chunks.
+ * Knows nothing about the engine, gravity and collision are passed into Tick
+ */
+class PROJECTILECORE_API FProjectileSimulation
+{
+public:
+
+	TArray<FProjectileChunk>		Chunks;			// the main data storage for projectiles
+	FHandleTable					HandleTable;	// projectile handle data for external access
+	TArray<FProjectileSimParams>	Configs;		// indexed by FProjectileChunk::ConfigId
+
+	bool							bDeterministic;		// fixed timestep, ordered destroys, per-step state hash
+	float							FixedTimestep;		// step used when bDeterministic
+	TArray<FProjectileHandle>		PendingDestroys;	// destroys deferred to the start of the next tick (deterministic mode)
+	float							TimeAccumulator;	// unsimulated time carried over to the next tick (deterministic mode)
+	uint32							StepNumber;			// number of fixed steps simulated so far (deterministic mode)
+	uint32							StateHash;			// hash of all chunks after the last simulated step (deterministic mode)
+
+	TArray<FProjectileDestroyEvent>	DestroyEvents;		// destroyed projectiles that have an owner, consumed by whoever dispatches them
+	TArray<FProjectileExplosion>	Explosions;			// explosive projectiles destroyed by a hit, consumed by whoever applies the damage
+
+	TArray<FProjectileTarget>		Targets;			// indexed by target id, 0 is reserved for "no target"
+	TArray<uint16>					FreeTargetIds;		// removed target ids that can be handed out again
+	uint32							MaxRetargetsPerFrame;	// homing projectiles that look for a new target per tick, over all chunks
+	uint32							RetargetChunkCursor;	// chunk that gets the retarget budget first, rotates every tick
+
+	bool							bTickInFlight;		// between BeginTick and EndTick
+	uint32							TickChunkCount;		// chunks simulated by the tick in flight, new ones are picked up next tick
+	uint32							TickSubstepCount;	// substeps the tick in flight runs
+	float							TickStepDt;			// delta of every substep of the tick in flight
+	float							TickGravityZ;
+	IProjectileCollisionWorld*		TickWorld;
+	TArray<FProjectileSimParams>	TickConfigs;		// copy of Configs, they can be added to while the tick is in flight
+	TArray<FProjectileTarget>		TickTargets;		// copy of Targets, for the same reason
+	TArray<FProjectileKill>			Kills;				// projectiles killed by the tick in flight
+	TArray<uint32>					TickDebugLinesLeft;	// per config, what is left of MaxDebugLines this tick
+
+	FProjectileSpatialIndex			SpatialIndex;		// built on the first query after projectiles moved
+	bool							bSpatialIndexDirty;	// projectiles moved, were created or destroyed since the last build
+
+	FProjectileSimStats				Stats;				// counters of the last tick, reset by BeginTick
+
+	uint32							MaxChunkSortsPerFrame;	// chunks re-sorted along a morton curve per tick, 0 never sorts
+	uint32							SortChunkCursor;		// next chunk to sort, round-robin
+	FProjectileChunk				SortScratch;			// chunk sized buffer the sort gathers into, swapped with the sorted chunk
+
+	bool							bPublishSnapshots;	// copy every projectile into Snapshots at the end of each tick
+	FProjectileSnapshotBuffer		Snapshots;			// lock free read access for other threads, see FProjectileSnapshotReadScope
+
+	float							StreamingCellSize;	// projectiles are grouped in 2D cells this size to check if the world is loaded, 0 doesn't
+	TSet<FIntPoint>					UnloadedCells;		// cells whose world isn't loaded, filled by the game before BeginTick
+	TSet<FIntPoint>					OccupiedCells;		// cells with projectiles in them after the last tick, what the game has to check
+	TSet<FIntPoint>					TickOccupiedCells;	// OccupiedCells of the tick in flight
+
+	uint32							SaturationHeadroom;	// handles kept free for spawns of ReservedPriority and above
+	uint8							ReservedPriority;	// configs below this can't spawn into the headroom and can be evicted to restore it
+	TArray<FVector>					EvictionFocus;		// what EvictFarthest measures from (players, cameras), set by the game before BeginTick
+	uint32							RejectedSinceTick;	// spawns refused since the last BeginTick, goes into Stats
+	TArray<FProjectileEvictionCandidate> EvictionCandidates;	// scratch for EvictForHeadroom, kept for the allocation
+
+	FProjectileSimulation();
+	~FProjectileSimulation();
+
+	void Init(uint32 MaxHandles);
+	void Shutdown();
+
+	/** registers a projectile type, the returned id is what CreateProjectile takes */
+	uint16 AddConfig(const FProjectileSimParams& Params);
+	/** creates empty chunks until Count projectiles of the config fit without allocating.
+		meant for level load, so the first volley doesn't pay for it. returns the number of chunks created */
+	uint32 ReserveProjectiles(uint16 ConfigId, uint32 Count);
+	/** sizes the handle table for Count live projectiles, clamped to MAX_PROJECTILE_HANDLES, and reserves the
+		per-projectile scratch arrays to match. it only shrinks before the first handle was given out, after that
+		it only grows so every handle stays valid. returns the capacity. not while a tick is in flight */
+	uint32 ReserveHandles(uint32 Count);
+	/** memory held by the chunks */
+	uint64 GetAllocatedBytes() const;
+
+	/** spawns a new projectile to be simulated. when OwnerId isn't 0 a FProjectileDestroyEvent
+		is added to DestroyEvents when the projectile is destroyed. returns FProjectileHandle::Invalid
+		when there is no room left for it, or only the headroom and its priority is below ReservedPriority */
+	FProjectileHandle CreateProjectile(uint16 ConfigId, const FVector& Location, const FRotator& Rotation, uint16 OwnerId = 0);
+	/** spawns a projectile that continues from an existing state, lifetime and bounces included */
+	FProjectileHandle CreateProjectileFromState(uint16 ConfigId, const FProjectileState& State, uint16 OwnerId = 0);
+	/** destroys the projectile right away and hands back everything needed to continue it elsewhere.
+		cannot be called while a tick is in flight. returns false if the handle is invalid */
+	bool RemoveProjectile(FProjectileHandle Handle, EProjectileDestroyReason Reason,
+		FProjectileState& OutState, uint16& OutConfigId, uint16& OutOwnerId);
+	/** destroys the projectile. cannot be called inside Tick. while a tick is in flight
+		the destroy is deferred to EndTick, in deterministic mode to the start of the next tick */
+	void DestroyProjectile(FProjectileHandle Handle);
+	/** gets the internal simulation state for a projectile. will return a stub if the
+		handle is valid so the code works. use IsProjectileValid for actual error handling */
+	FProjectileState* GetProjectileState(FProjectileHandle Handle);
+	/** test if the handle refers to a valid projectile */
+	bool IsProjectileValid(FProjectileHandle Handle) const;
+
+	/** forgets an owner so its id can be handed out again. its projectiles keep flying without an owner
+		its pending destroy events are dropped and its pending explosions go off without an owner */
+	void ClearOwner(uint16 OwnerId);
+
+	/** registers something homing projectiles can lock on to. returns 0 if there are too many.
+		ids are reused, projectiles still tracking a removed target pick a new one on their next retarget */
+	uint16 AddTarget(const FVector& Location);
+	void RemoveTarget(uint16 TargetId);
+	/** targets are expected to move, call this every frame before the tick */
+	void SetTargetLocation(uint16 TargetId, const FVector& Location);
+
+	/** appends the handle of every projectile within Radius of Center. while a tick is in flight
+		this sees where projectiles were before it, the states can't be read until it's done */
+	void QueryRadius(const FVector& Center, float Radius, TArray<FProjectileHandle>& OutHandles);
+	/** appends the handle of every projectile inside Box */
+	void QueryBox(const FBox& Box, TArray<FProjectileHandle>& OutHandles);
+	/** appends the handle of every projectile within Radius of the segment from Start to End */
+	void QuerySegment(const FVector& Start, const FVector& End, float Radius, TArray<FProjectileHandle>& OutHandles);
+
+	/** hashes the state of every chunk. identical simulations produce identical hashes */
+	uint32 ComputeStateHash() const;
+
+	/** advances every projectile by DeltaTime, tracing against World. same as BeginTick, SimulateTick, EndTick */
+	void Tick(float DeltaTime, float GravityZ, IProjectileCollisionWorld& World);
+
+	/**
+	 * The tick split up so the expensive part can run on another thread.
+	 * between BeginTick and EndTick projectiles can be created and destroyed (deferred) but their
+	 * states must not be read or written, the tick in flight owns them
+	 */
+	void BeginTick(float DeltaTime, float GravityZ, IProjectileCollisionWorld& World);
+	/** integrates, traces and finalizes every projectile. safe to call from any thread */
+	void SimulateTick();
+	/** destroys everything the tick killed. must be called on the thread that owns the simulation */
+	void EndTick();
+
+	/** the chunk for ConfigId with space left whose bounds are closest to Location, or a new one.
+		INDEX_NONE when every chunk is taken */
+	int32 GetOrCreateChunk(uint16 ConfigId, const FVector& Location);
+	/** reorders a chunk along a morton curve so neighbouring projectiles trace neighbouring geometry */
+	void SortChunk(uint32 ChunkIndex);
+	/** moves the projectiles in UnloadedCells to the end of what the tick simulates, sets TickActiveCount */
+	void PartitionUnloaded(uint32 ChunkIndex);
+	/** streaming cell Location is in */
+	FIntPoint GetStreamingCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt32(Location.X / StreamingCellSize), FMath::FloorToInt32(Location.Y / StreamingCellSize));
+	}
+	void DestroyProjectileImmediate(FProjectileHandle Handle, EProjectileDestroyReason Reason, const FVector* Location = nullptr);
+	void FlushPendingDestroys();
+	/** rebuilds the spatial index if anything changed since the last query */
+	void UpdateSpatialIndex();
+	/** homing projectiles look for a new target, limited to MaxRetargetsPerFrame */
+	void AcquireTargets();
+	/** destroys low priority projectiles in bulk until SaturationHeadroom handles are free again */
+	void EvictForHeadroom();
+};
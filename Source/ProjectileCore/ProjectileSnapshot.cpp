@@ -0,0 +1,108 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileSnapshot.h"
+#include "ProjectileSimulation.h"
+
+FProjectileSnapshotBuffer::FProjectileSnapshotBuffer()
+	: Latest(INDEX_NONE)
+	, FrameNumber(0)
+	, DroppedCount(0)
+{
+	for (std::atomic<int32>& Count : ReaderCounts)
+	{
+		Count = 0;
+	}
+}
+
+bool FProjectileSnapshotBuffer::Publish(const FProjectileChunk* Chunks, uint32 ChunkCount, float StepTime, float Alpha)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSnapshotBuffer::Publish);
+
+	// any buffer that isn't the published one and has no readers is ours.
+	// a reader can still pin it after this check, but it'll see it's not the latest and back off
+	int32 LatestIndex = Latest.load();
+	int32 WriteIndex = INDEX_NONE;
+	for (int32 I = 0; I < PROJECTILE_SNAPSHOT_BUFFER_COUNT; ++I)
+	{
+		if (I != LatestIndex && ReaderCounts[I].load() == 0)
+		{
+			WriteIndex = I;
+			break;
+		}
+	}
+
+	if (WriteIndex == INDEX_NONE)
+	{
+		++DroppedCount;
+		return false;
+	}
+
+	uint32 Total = 0;
+	for (uint32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+	{
+		Total += Chunks[ChunkIndex].Count;
+	}
+
+	FProjectileSnapshot& Snapshot = Snapshots[WriteIndex];
+	Snapshot.FrameNumber = ++FrameNumber;
+	Snapshot.StepTime = StepTime;
+	Snapshot.Alpha = Alpha;
+	Snapshot.Handles.SetNumUninitialized(Total, false);
+	Snapshot.ConfigIds.SetNumUninitialized(Total, false);
+	Snapshot.PrevPositions.SetNumUninitialized(Total, false);
+	Snapshot.Positions.SetNumUninitialized(Total, false);
+	Snapshot.Velocities.SetNumUninitialized(Total, false);
+
+	uint32 Offset = 0;
+	for (uint32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+	{
+		const FProjectileChunk& Chunk = Chunks[ChunkIndex];
+
+		FMemory::Memcpy(Snapshot.Handles.GetData() + Offset, Chunk.Handles, sizeof(FProjectileHandle) * Chunk.Count);
+		FMemory::Memcpy(Snapshot.PrevPositions.GetData() + Offset, Chunk.PrevPositions, sizeof(FVector) * Chunk.Count);
+
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			Snapshot.ConfigIds[Offset + I] = Chunk.ConfigId;
+			Snapshot.Positions[Offset + I] = Chunk.States[I].Position;
+			Snapshot.Velocities[Offset + I] = Chunk.States[I].Velocity;
+		}
+
+		Offset += Chunk.Count;
+	}
+
+	Latest.store(WriteIndex);
+	return true;
+}
+
+const FProjectileSnapshot* FProjectileSnapshotBuffer::Acquire()
+{
+	for (;;)
+	{
+		int32 Index = Latest.load();
+		if (Index == INDEX_NONE)
+		{
+			return nullptr;
+		}
+
+		// pin it, then make sure it's still the published one. if it isn't the writer may
+		// have picked it before we pinned it, so try again with the newer one
+		++ReaderCounts[Index];
+		if (Latest.load() == Index)
+		{
+			return &Snapshots[Index];
+		}
+
+		--ReaderCounts[Index];
+	}
+}
+
+void FProjectileSnapshotBuffer::Release(const FProjectileSnapshot* Snapshot)
+{
+	if (Snapshot)
+	{
+		int32 Index = (int32)(Snapshot - Snapshots);
+		check(Index >= 0 && Index < PROJECTILE_SNAPSHOT_BUFFER_COUNT);
+		--ReaderCounts[Index];
+	}
+}
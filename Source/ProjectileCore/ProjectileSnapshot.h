@@ -0,0 +1,85 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProjectileHandle.h"
+#include <atomic>
+
+struct FProjectileChunk;
+
+// number of snapshot buffers. one being written, one published, one for a reader that is still busy with an old one
+#define PROJECTILE_SNAPSHOT_BUFFER_COUNT (3)
+
+/**
+ * Immutable copy of every live projectile at the end of a tick, for code outside the game thread.
+ * Holds the previous and current position of every projectile so readers can interpolate between sim steps
+ */
+struct PROJECTILECORE_API FProjectileSnapshot
+{
+	uint32						FrameNumber;	// increments with every published snapshot
+	float						StepTime;		// time between PrevPositions and Positions
+	float						Alpha;			// how far the game clock is past Positions in StepTime, lerp Prev->Current by this
+	TArray<FProjectileHandle>	Handles;
+	TArray<uint16>				ConfigIds;
+	TArray<FVector>				PrevPositions;	// before the last sim step
+	TArray<FVector>				Positions;		// after the last sim step
+	TArray<FVector3f>			Velocities;
+
+	int32 Num() const { return Handles.Num(); }
+
+	/** where to draw projectile Index right now */
+	FVector GetInterpolatedPosition(int32 Index) const
+	{
+		return FMath::Lerp(PrevPositions[Index], Positions[Index], (double)Alpha);
+	}
+};
+
+/**
+ * Lock free publishing of FProjectileSnapshot. The game thread fills a buffer nobody is reading and publishes it
+ * with an atomic swap, readers pin whatever was published last for as long as they need it
+ */
+class PROJECTILECORE_API FProjectileSnapshotBuffer
+{
+public:
+
+	FProjectileSnapshotBuffer();
+
+	/** fills a free buffer from the chunks and publishes it. returns false if every buffer was busy
+		and nothing was published. simulation thread only */
+	bool Publish(const FProjectileChunk* Chunks, uint32 ChunkCount, float StepTime, float Alpha);
+
+	/** pins the latest snapshot, must be matched by Release. null if nothing was published yet. any thread */
+	const FProjectileSnapshot* Acquire();
+	void Release(const FProjectileSnapshot* Snapshot);
+
+	uint32 GetDroppedCount() const { return DroppedCount; }
+
+private:
+
+	FProjectileSnapshot			Snapshots[PROJECTILE_SNAPSHOT_BUFFER_COUNT];
+	std::atomic<int32>			ReaderCounts[PROJECTILE_SNAPSHOT_BUFFER_COUNT];
+	std::atomic<int32>			Latest;			// published buffer, INDEX_NONE before the first publish
+	uint32						FrameNumber;
+	uint32						DroppedCount;	// publishes skipped because readers held on to every other buffer
+};
+
+/** Pins the latest snapshot for the lifetime of the scope */
+struct FProjectileSnapshotReadScope
+{
+	FProjectileSnapshotBuffer&	Buffer;
+	const FProjectileSnapshot*	Snapshot;
+
+	explicit FProjectileSnapshotReadScope(FProjectileSnapshotBuffer& InBuffer)
+		: Buffer(InBuffer)
+		, Snapshot(InBuffer.Acquire())
+	{
+	}
+
+	~FProjectileSnapshotReadScope()
+	{
+		Buffer.Release(Snapshot);
+	}
+
+	UE_NONCOPYABLE(FProjectileSnapshotReadScope);
+};
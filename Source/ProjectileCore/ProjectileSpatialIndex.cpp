@@ -0,0 +1,186 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileSpatialIndex.h"
+#include "ProjectileSimulation.h"
+#include "Async/ParallelFor.h"
+
+FProjectileSpatialIndex::FProjectileSpatialIndex()
+	: CellSize(500.0f)
+	, BucketMask(0)
+{
+}
+
+FIntVector FProjectileSpatialIndex::GetCell(const FVector& Position) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Position.X / CellSize),
+		FMath::FloorToInt32(Position.Y / CellSize),
+		FMath::FloorToInt32(Position.Z / CellSize));
+}
+
+uint32 FProjectileSpatialIndex::GetBucket(const FIntVector& Cell) const
+{
+	// the usual spatial hashing primes, good enough to spread neighbouring cells
+	uint32 Hash = ((uint32)Cell.X * 73856093u) ^ ((uint32)Cell.Y * 19349663u) ^ ((uint32)Cell.Z * 83492791u);
+	return Hash & BucketMask;
+}
+
+void FProjectileSpatialIndex::Build(const FProjectileChunk* Chunks, uint32 ChunkCount)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSpatialIndex::Build);
+
+	// where every chunk starts in the flat entry list
+	uint32 ChunkOffsets[MAX_CHUNK_COUNT + 1];
+	ChunkOffsets[0] = 0;
+	for (uint32 I = 0; I < ChunkCount; ++I)
+	{
+		ChunkOffsets[I + 1] = ChunkOffsets[I] + Chunks[I].Count;
+	}
+
+	uint32 Total = ChunkOffsets[ChunkCount];
+
+	// about one bucket per projectile keeps the buckets short without wasting memory
+	uint32 BucketCount = FMath::RoundUpToPowerOfTwo(FMath::Max(Total, 1u));
+	BucketMask = BucketCount - 1;
+
+	EntryBuckets.SetNumUninitialized(Total, false);
+	Entries.SetNumUninitialized(Total, false);
+	BucketStarts.Reset();
+	BucketStarts.SetNumZeroed(BucketCount + 1, false);
+	VisitedBuckets.Init(false, (int32)BucketCount);
+
+	// hashing is the expensive part and every chunk is independent
+	ParallelFor(ChunkCount, [&](int32 ChunkIndex)
+	{
+		const FProjectileChunk& Chunk = Chunks[ChunkIndex];
+		uint32* Buckets = EntryBuckets.GetData() + ChunkOffsets[ChunkIndex];
+
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			Buckets[I] = GetBucket(GetCell(Chunk.States[I].Position));
+		}
+	});
+
+	// counting sort by bucket
+	for (uint32 Bucket : EntryBuckets)
+	{
+		++BucketStarts[Bucket + 1];
+	}
+
+	for (uint32 I = 0; I < BucketCount; ++I)
+	{
+		BucketStarts[I + 1] += BucketStarts[I];
+	}
+
+	// scatter, moving the starts forward as we go. they are shifted back afterwards
+	for (uint32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+	{
+		const FProjectileChunk& Chunk = Chunks[ChunkIndex];
+		const uint32* Buckets = EntryBuckets.GetData() + ChunkOffsets[ChunkIndex];
+
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			FEntry& Entry = Entries[BucketStarts[Buckets[I]]++];
+			Entry.Position = Chunk.States[I].Position;
+			Entry.Handle = Chunk.Handles[I];
+		}
+	}
+
+	for (uint32 I = BucketCount; I > 0; --I)
+	{
+		BucketStarts[I] = BucketStarts[I - 1];
+	}
+
+	BucketStarts[0] = 0;
+}
+
+template<typename TestType>
+void FProjectileSpatialIndex::Query(const FBox& Bounds, TestType Test, TArray<FProjectileHandle>& OutHandles)
+{
+	if (Entries.Num() == 0)
+	{
+		return;
+	}
+
+	FIntVector Min = GetCell(Bounds.Min);
+	FIntVector Max = GetCell(Bounds.Max);
+
+	int64 CellCount = (int64)(Max.X - Min.X + 1) * (int64)(Max.Y - Min.Y + 1) * (int64)(Max.Z - Min.Z + 1);
+	if (CellCount >= Entries.Num())
+	{
+		// huge query compared to the number of projectiles, just look at all of them
+		for (const FEntry& Entry : Entries)
+		{
+			if (Test(Entry.Position))
+			{
+				OutHandles.Add(Entry.Handle);
+			}
+		}
+		return;
+	}
+
+	// different cells can hash to the same bucket, only visit each bucket once
+	VisitedBuckets.SetRange(0, VisitedBuckets.Num(), false);
+
+	for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				uint32 Bucket = GetBucket(FIntVector(X, Y, Z));
+				FBitReference Visited = VisitedBuckets[(int32)Bucket];
+				if (Visited)
+				{
+					continue;
+				}
+
+				Visited = true;
+
+				for (uint32 I = BucketStarts[Bucket]; I < BucketStarts[Bucket + 1]; ++I)
+				{
+					const FEntry& Entry = Entries[I];
+					if (Test(Entry.Position))
+					{
+						OutHandles.Add(Entry.Handle);
+					}
+				}
+			}
+		}
+	}
+}
+
+void FProjectileSpatialIndex::QueryRadius(const FVector& Center, float Radius, TArray<FProjectileHandle>& OutHandles)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSpatialIndex::QueryRadius);
+
+	double RadiusSq = FMath::Square((double)Radius);
+	Query(FBox(Center - Radius, Center + Radius), [&](const FVector& Position)
+	{
+		return FVector::DistSquared(Position, Center) <= RadiusSq;
+	}, OutHandles);
+}
+
+void FProjectileSpatialIndex::QueryBox(const FBox& Box, TArray<FProjectileHandle>& OutHandles)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSpatialIndex::QueryBox);
+
+	Query(Box, [&](const FVector& Position)
+	{
+		return Box.IsInsideOrOn(Position);
+	}, OutHandles);
+}
+
+void FProjectileSpatialIndex::QuerySegment(const FVector& Start, const FVector& End, float Radius, TArray<FProjectileHandle>& OutHandles)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileSpatialIndex::QuerySegment);
+
+	// NOTE(dennis): long segments cover a lot of cells they don't touch, walk the cells if that ever matters
+	FBox Bounds(Start.ComponentMin(End) - Radius, Start.ComponentMax(End) + Radius);
+	double RadiusSq = FMath::Square((double)Radius);
+
+	Query(Bounds, [&](const FVector& Position)
+	{
+		return FMath::PointDistToSegmentSquared(Position, Start, End) <= RadiusSq;
+	}, OutHandles);
+}
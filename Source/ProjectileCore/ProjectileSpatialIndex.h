@@ -0,0 +1,53 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProjectileHandle.h"
+
+struct FProjectileChunk;
+
+/**
+ * Hashed uniform grid over projectile positions, answers "which projectiles are near X".
+ * Built from scratch out of the chunks, there is no incremental update since everything moves every frame.
+ * Buckets are shared by every cell hashing into them, so queries always test the actual positions
+ */
+class PROJECTILECORE_API FProjectileSpatialIndex
+{
+public:
+
+	/** An indexed projectile, grouped by bucket */
+	struct FEntry
+	{
+		FVector				Position;
+		FProjectileHandle	Handle;
+	};
+
+	float					CellSize;		// world size of a grid cell
+	TArray<FEntry>			Entries;		// sorted by bucket
+	TArray<uint32>			BucketStarts;	// first entry of every bucket, one extra at the end
+	TArray<uint32>			EntryBuckets;	// bucket of every projectile in chunk order, scratch for the build
+	uint32					BucketMask;		// bucket count - 1, always a power of two
+	TBitArray<>				VisitedBuckets;	// one bit per bucket, scratch for the queries
+
+	FProjectileSpatialIndex();
+
+	/** indexes the first Count projectiles of every chunk */
+	void Build(const FProjectileChunk* Chunks, uint32 ChunkCount);
+
+	/** appends every projectile within Radius of Center */
+	void QueryRadius(const FVector& Center, float Radius, TArray<FProjectileHandle>& OutHandles);
+	/** appends every projectile inside Box */
+	void QueryBox(const FBox& Box, TArray<FProjectileHandle>& OutHandles);
+	/** appends every projectile within Radius of the segment */
+	void QuerySegment(const FVector& Start, const FVector& End, float Radius, TArray<FProjectileHandle>& OutHandles);
+
+private:
+
+	FIntVector GetCell(const FVector& Position) const;
+	uint32 GetBucket(const FIntVector& Cell) const;
+
+	/** calls Test for every entry in the buckets of the cells overlapping Bounds */
+	template<typename TestType>
+	void Query(const FBox& Bounds, TestType Test, TArray<FProjectileHandle>& OutHandles);
+};
@@ -0,0 +1,142 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileStubWorld.h"
+
+FProjectileStubCollisionWorld::FProjectileStubCollisionWorld()
+	: TraceCount(0)
+{
+}
+
+void FProjectileStubCollisionWorld::TraceSegments(const FVector* Starts, const FVector* Ends,
+	uint32 Count, FProjectileHit* OutHits, EProjectileTraceType Type)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileStubCollisionWorld::TraceSegments);
+
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		OutHits[I] = Trace(Starts[I], Ends[I], Type);
+	}
+
+	TraceCount += Count;
+}
+
+FProjectileHit FProjectileStubCollisionWorld::TraceSegment(const FVector& Start, const FVector& End, EProjectileTraceType Type)
+{
+	++TraceCount;
+	return Trace(Start, End, Type);
+}
+
+/** slab test against a single box. returns false if Start is inside the box */
+static bool TraceBox(const FBox& Box, const FVector& Start, const FVector& Delta, FProjectileHit& Hit)
+{
+	if (Box.IsInsideOrOn(Start))
+	{
+		Hit = {};
+		Hit.bStartPenetrating = true;
+		return false;
+	}
+
+	// slab test, keep track of which axis we entered through for the normal
+	double TMin = 0.0;
+	double TMax = 1.0;
+	int32 EntryAxis = INDEX_NONE;
+	double EntrySign = 0.0;
+	bool bMiss = false;
+
+	for (int32 Axis = 0; Axis < 3 && !bMiss; ++Axis)
+	{
+		if (FMath::IsNearlyZero(Delta[Axis]))
+		{
+			bMiss = Start[Axis] < Box.Min[Axis] || Start[Axis] > Box.Max[Axis];
+			continue;
+		}
+
+		double InvDelta = 1.0 / Delta[Axis];
+		double T0 = (Box.Min[Axis] - Start[Axis]) * InvDelta;
+		double T1 = (Box.Max[Axis] - Start[Axis]) * InvDelta;
+		double Sign = -1.0;
+		if (T0 > T1)
+		{
+			Swap(T0, T1);
+			Sign = 1.0;
+		}
+
+		if (T0 > TMin)
+		{
+			TMin = T0;
+			EntryAxis = Axis;
+			EntrySign = Sign;
+		}
+
+		TMax = FMath::Min(TMax, T1);
+		bMiss = TMin > TMax;
+	}
+
+	if (!bMiss && EntryAxis != INDEX_NONE && TMin < Hit.Time)
+	{
+		Hit.Time = (float)TMin;
+		Hit.Normal = FVector3f::ZeroVector;
+		Hit.Normal[EntryAxis] = (float)EntrySign;
+		Hit.bBlockingHit = true;
+	}
+
+	return true;
+}
+
+FProjectileHit FProjectileStubCollisionWorld::Trace(const FVector& Start, const FVector& End, EProjectileTraceType Type) const
+{
+	FProjectileHit Hit = {};
+	Hit.Time = 1.0f;
+
+	FVector Delta = End - Start;
+
+	if (Type != EProjectileTraceType::Dynamic)
+	{
+		for (const FPlane& Plane : Planes)
+		{
+			double StartDist = Plane.PlaneDot(Start);
+			double EndDist = Plane.PlaneDot(End);
+
+			if (StartDist < 0.0)
+			{
+				Hit = {};
+				Hit.bStartPenetrating = true;
+				Hit.Normal = FVector3f(Plane.GetNormal());
+				return Hit;
+			}
+
+			// only hits when going from the open side into the solid side
+			if (EndDist < 0.0)
+			{
+				float Time = (float)(StartDist / (StartDist - EndDist));
+				if (Time < Hit.Time)
+				{
+					Hit.Time = Time;
+					Hit.Normal = FVector3f(Plane.GetNormal());
+					Hit.bBlockingHit = true;
+				}
+			}
+		}
+
+		for (const FBox& Box : Boxes)
+		{
+			if (!TraceBox(Box, Start, Delta, Hit))
+			{
+				return Hit;
+			}
+		}
+	}
+
+	if (Type != EProjectileTraceType::Static)
+	{
+		for (const FBox& Box : DynamicBoxes)
+		{
+			if (!TraceBox(Box, Start, Delta, Hit))
+			{
+				return Hit;
+			}
+		}
+	}
+
+	return Hit;
+}
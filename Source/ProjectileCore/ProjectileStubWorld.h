@@ -0,0 +1,31 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProjectileSimulation.h"
+
+/**
+ * Minimal collision world made of infinite planes and axis aligned boxes.
+ * Lets the simulation run without an engine, for unit tests, fuzzing and microbenchmarks
+ */
+class PROJECTILECORE_API FProjectileStubCollisionWorld : public IProjectileCollisionWorld
+{
+public:
+
+	TArray<FPlane>	Planes;		// solid behind the plane, the normal points into open space
+	TArray<FBox>	Boxes;		// solid boxes
+	TArray<FBox>	DynamicBoxes;	// solid boxes that only show up in dynamic traces, the rest is static
+	uint64			TraceCount;	// number of segments traced so far
+
+	FProjectileStubCollisionWorld();
+
+	// ~ begin IProjectileCollisionWorld interface
+	virtual void TraceSegments(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+		EProjectileTraceType Type) override;
+	virtual FProjectileHit TraceSegment(const FVector& Start, const FVector& End, EProjectileTraceType Type) override;
+	// ~ end IProjectileCollisionWorld interface
+
+	/** traces a single segment against every plane and box without counting it */
+	FProjectileHit Trace(const FVector& Start, const FVector& End, EProjectileTraceType Type) const;
+};
@@ -0,0 +1,25 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+using UnrealBuildTool;
+using System.Collections.Generic;
+
+/** Console program that fuzzes and benchmarks ProjectileCore without booting the engine */
+[SupportedPlatforms(UnrealPlatformClass.Desktop)]
+public class ProjectileCoreTestsTarget : TargetRules
+{
+	public ProjectileCoreTestsTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Program;
+		LinkType = TargetLinkType.Monolithic;
+		DefaultBuildSettings = BuildSettingsVersion.V2;
+		LaunchModuleName = "ProjectileCoreTests";
+
+		bBuildDeveloperTools = false;
+		bBuildWithEditorOnlyData = false;
+		bCompileAgainstEngine = false;
+		bCompileAgainstCoreUObject = false;
+		bCompileAgainstApplicationCore = false;
+		bCompileICU = false;
+		bIsBuildingConsoleApplication = true;
+	}
+}
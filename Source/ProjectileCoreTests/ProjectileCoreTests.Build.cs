@@ -0,0 +1,15 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+using UnrealBuildTool;
+
+/** Fuzz tests and microbenchmarks for ProjectileCore, see ProjectileCoreTests.Target.cs */
+public class ProjectileCoreTests : ModuleRules
+{
+	public ProjectileCoreTests(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+		CppStandard = CppStandardVersion.Cpp20;
+		PublicIncludePathModuleNames.Add("Launch");
+		PrivateDependencyModuleNames.AddRange(new string[] { "Core", "Projects", "ProjectileCore" });
+	}
+}
@@ -0,0 +1,637 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "RequiredProgramMainCPPInclude.h"
+#include "ProjectileHandle.h"
+#include "ProjectileSimulation.h"
+#include "ProjectileSnapshot.h"
+#include "ProjectileExplosion.h"
+#include "ProjectileStubWorld.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogProjectileCoreTests, Log, All);
+
+IMPLEMENT_APPLICATION(ProjectileCoreTests, "ProjectileCoreTests");
+
+/** fails the running test, the seed is logged by whoever runs it so the failure can be replayed */
+#define PROJECTILE_TEST(Expr) \
+	if (!(Expr)) \
+	{ \
+		UE_LOG(LogProjectileCoreTests, Error, TEXT("%s(%d): %s failed"), TEXT(__FILE__), __LINE__, TEXT(#Expr)); \
+		return false; \
+	}
+
+/**
+ * Random Claim/Release/IsValid against a table small enough to run out.
+ * The table is compared against a plain version counter per index
+ */
+static bool FuzzHandleTable(int32 Seed, uint32 Iterations)
+{
+	FRandomStream Random(Seed);
+
+	FHandleTable Table;
+	const uint32 MaxCount = 1 + (uint32)Random.RandHelper(1024);
+	Table.Init(MaxCount);
+
+	TArray<uint16> ExpectedVersion;
+	ExpectedVersion.Init(0, MaxCount);
+	TBitArray<> Claimed(false, MaxCount);
+	TArray<FProjectileHandle> Live;
+
+	for (uint32 I = 0; I < Iterations; ++I)
+	{
+		int32 Op = Random.RandHelper(4);
+		if (Op <= 1 || Live.Num() == 0)
+		{
+			FProjectileHandle Handle = Table.Claim();
+			if ((uint32)Live.Num() == MaxCount)
+			{
+				PROJECTILE_TEST(Handle == FProjectileHandle::Invalid());
+				PROJECTILE_TEST(!Table.IsValid(Handle));
+				continue;
+			}
+
+			PROJECTILE_TEST(Handle.Index < MaxCount);
+			PROJECTILE_TEST(!Claimed[Handle.Index]);
+			PROJECTILE_TEST(Handle.Version == ExpectedVersion[Handle.Index]);
+			PROJECTILE_TEST(Table.IsValid(Handle));
+
+			Claimed[Handle.Index] = true;
+			Live.Add(Handle);
+		}
+		else if (Op == 2)
+		{
+			int32 Pick = Random.RandHelper(Live.Num());
+			FProjectileHandle Handle = Live[Pick];
+			Live.RemoveAtSwap(Pick);
+
+			Table.Release(Handle);
+			Claimed[Handle.Index] = false;
+			++ExpectedVersion[Handle.Index];
+
+			// the released handle must never resolve again, until the version wraps around
+			PROJECTILE_TEST(!Table.IsValid(Handle));
+		}
+		else
+		{
+			// random probes, including indices past the end and the invalid handle
+			FProjectileHandle Probe;
+			Probe.Index = Random.RandHelper(64) == 0 ? FProjectileHandle::Invalid().Index : (uint16)Random.RandHelper(MaxCount + 2);
+			Probe.Version = Random.RandHelper(2) == 0 && Probe.Index < MaxCount
+				? ExpectedVersion[Probe.Index] : (uint16)Random.RandHelper(TNumericLimits<uint16>::Max());
+
+			bool bExpected = Probe.Index < MaxCount && ExpectedVersion[Probe.Index] == Probe.Version;
+			PROJECTILE_TEST(Table.IsValid(Probe) == bExpected);
+		}
+
+		PROJECTILE_TEST(Table.GetFreeCount() + (uint32)Live.Num() == MaxCount);
+	}
+
+	for (FProjectileHandle Handle : Live)
+	{
+		PROJECTILE_TEST(Table.IsValid(Handle));
+	}
+
+	return true;
+}
+
+/** ground plane with a few walls, roughly what the demo map spawns into */
+static void BuildStubWorld(FProjectileStubCollisionWorld& World, FRandomStream& Random)
+{
+	World.Planes.Add(FPlane(FVector::UpVector, 0.0));
+
+	for (int32 I = 0; I < 16; ++I)
+	{
+		FVector Center(Random.FRandRange(-20000.0f, 20000.0f), Random.FRandRange(-20000.0f, 20000.0f), 500.0f);
+		FVector Extent(Random.FRandRange(50.0f, 1000.0f), Random.FRandRange(50.0f, 1000.0f), 500.0f);
+		World.Boxes.Add(FBox(Center - Extent, Center + Extent));
+	}
+
+	for (int32 I = 0; I < 4; ++I)
+	{
+		FVector Center(Random.FRandRange(-20000.0f, 20000.0f), Random.FRandRange(-20000.0f, 20000.0f), 200.0f);
+		World.DynamicBoxes.Add(FBox(Center - FVector(200.0f), Center + FVector(200.0f)));
+	}
+}
+
+/**
+ * one config per kernel path worth covering: straight, rotating with a short life and adaptive traces, falling and
+ * exploding with drag and wind, bouncing with a lookahead, and homing. rotating, falling and homing cover the unloaded policies,
+ * homing is the only one below the reserved priority and gets evicted when saturated
+ */
+static void AddStubConfigs(FProjectileSimulation& Simulation, TArray<uint16>& OutConfigIds)
+{
+	FProjectileSimParams Params = {};
+	Params.InitialSpeed = 10000.0f;
+	Params.MaxLifetime = 3.0f;
+	Params.Priority = 128;
+	OutConfigIds.Add(Simulation.AddConfig(Params));
+
+	FProjectileSimParams Rotating = Params;
+	Rotating.InitialSpeed = 3000.0f;
+	Rotating.MaxLifetime = 0.5f;
+	Rotating.bRotationFollowsVelocity = true;
+	Rotating.GravityScale = 1.0f;
+	Rotating.TraceErrorTolerance = 5.0f;
+	Rotating.UnloadedPolicy = EProjectileUnloadedPolicy::Freeze;
+	OutConfigIds.Add(Simulation.AddConfig(Rotating));
+
+	FProjectileSimParams Falling = Params;
+	Falling.MaxSpeed = 12000.0f;
+	Falling.GravityScale = 1.0f;
+	Falling.DragCoefficient = 0.0001f;
+	Falling.Wind = FVector3f(300.0f, 0.0f, 0.0f);
+	Falling.ExplosionRadius = 300.0f;
+	Falling.TraceErrorTolerance = 5.0f;	// ignored, drag takes the plain path
+	Falling.UnloadedPolicy = EProjectileUnloadedPolicy::Ballistic;
+	OutConfigIds.Add(Simulation.AddConfig(Falling));
+
+	FProjectileSimParams Bouncing = Params;
+	Bouncing.GravityScale = 1.0f;
+	Bouncing.MaxBounces = 3;
+	Bouncing.MaxPenetrations = 1;
+	Bouncing.Restitution = 0.6f;
+	Bouncing.BounceFriction = 0.2f;
+	Bouncing.MinBounceSpeed = 100.0f;
+	Bouncing.PenetrationSpeedRetention = 0.5f;
+	Bouncing.PenetrationDepth[0] = 20.0f;
+	Bouncing.LookaheadDistance = 5000.0f;
+	Bouncing.LookaheadTolerance = 10.0f;
+	OutConfigIds.Add(Simulation.AddConfig(Bouncing));
+
+	FProjectileSimParams Homing = Params;
+	Homing.InitialSpeed = 3000.0f;
+	Homing.DragCoefficient = 0.0001f;
+	Homing.bHoming = true;
+	Homing.TurnRate = FMath::DegreesToRadians(180.0f);
+	Homing.AcquisitionCosHalfAngle = FMath::Cos(FMath::DegreesToRadians(60.0f));
+	Homing.AcquisitionRange = 20000.0f;
+	Homing.UnloadedPolicy = EProjectileUnloadedPolicy::Expire;
+	Homing.Priority = 0;
+	Homing.SaturationPolicy = EProjectileSaturationPolicy::EvictOldest;
+	OutConfigIds.Add(Simulation.AddConfig(Homing));
+}
+
+static FVector RandomSpawnLocation(FRandomStream& Random)
+{
+	return FVector(Random.FRandRange(-20000.0f, 20000.0f), Random.FRandRange(-20000.0f, 20000.0f), Random.FRandRange(100.0f, 2000.0f));
+}
+
+static FRotator RandomSpawnRotation(FRandomStream& Random)
+{
+	return FRotator(Random.FRandRange(-45.0f, 45.0f), Random.FRandRange(-180.0f, 180.0f), 0.0f);
+}
+
+/** every chunk slot points at a valid handle, and that handle resolves back to the same slot */
+static bool CheckSimulationInvariants(FProjectileSimulation& Simulation)
+{
+	uint32 Count = 0;
+	for (FProjectileChunk& Chunk : Simulation.Chunks)
+	{
+		PROJECTILE_TEST(!Chunk.bInsideTick);
+		PROJECTILE_TEST(Chunk.Count <= MAX_CHUNK_PROJECTILE_COUNT);
+
+		for (uint32 I = 0; I < Chunk.Count; ++I)
+		{
+			FProjectileHandle Handle = Chunk.Handles[I];
+			PROJECTILE_TEST(Simulation.IsProjectileValid(Handle));
+			PROJECTILE_TEST(Simulation.GetProjectileState(Handle) == Chunk.States + I);
+			PROJECTILE_TEST(!Chunk.States[I].Position.ContainsNaN());
+			PROJECTILE_TEST(!Chunk.States[I].Velocity.ContainsNaN());
+		}
+
+		Count += Chunk.Count;
+	}
+
+	// projectiles waiting on a deferred destroy still hold their handle
+	PROJECTILE_TEST(Count + Simulation.HandleTable.GetFreeCount() == Simulation.HandleTable.MaxCount);
+	return true;
+}
+
+/** whether a create of this config should be accepted, only the high priority ones may use the headroom */
+static bool CanSpawn(const FProjectileSimulation& Simulation, uint16 ConfigId)
+{
+	uint32 FreeCount = Simulation.HandleTable.GetFreeCount();
+	return FreeCount > Simulation.SaturationHeadroom
+		|| (FreeCount > 0 && Simulation.Configs[ConfigId].Priority >= Simulation.ReservedPriority);
+}
+
+/**
+ * Random creates, destroys and ticks against the stub world, checking the handle/lookup
+ * invariants after every operation. OutHash is the final state hash in deterministic mode
+ */
+static bool FuzzSimulation(int32 Seed, uint32 Iterations, bool bDeterministic, uint32& OutHash)
+{
+	FRandomStream Random(Seed);
+
+	FProjectileStubCollisionWorld World;
+	BuildStubWorld(World, Random);
+
+	// small enough to run out of handles now and then
+	const uint32 MaxHandles = 256 + (uint32)Random.RandHelper(2048);
+
+	FProjectileSimulation Simulation;
+	Simulation.Init(MaxHandles);
+	Simulation.bDeterministic = bDeterministic;
+	Simulation.MaxChunkSortsPerFrame = 2;
+	Simulation.bPublishSnapshots = (Seed & 1) != 0;
+	Simulation.StreamingCellSize = (Seed & 2) != 0 ? 5000.0f : 0.0f;
+	Simulation.SaturationHeadroom = (Seed & 4) != 0 ? MaxHandles / 8 : 0;
+	Simulation.ReservedPriority = 128;
+
+	TArray<uint16> ConfigIds;
+	AddStubConfigs(Simulation, ConfigIds);
+
+	// a budgeted start, empty chunks up front and a table sized down before any handle was given out
+	if (Seed % 3 == 0)
+	{
+		Simulation.ReserveProjectiles(ConfigIds[0], 512);
+		PROJECTILE_TEST(Simulation.ReserveHandles(MaxHandles / 2) == MaxHandles / 2);
+	}
+
+	uint16 TargetId = Simulation.AddTarget(RandomSpawnLocation(Random));
+	PROJECTILE_TEST(TargetId != 0);
+
+	TArray<FProjectileHandle> Live;
+	TArray<FProjectileHandle> Destroyed;
+	TArray<FProjectileHandle> QueryResult;
+	TArray<FProjectileExplosionCluster> Clusters;
+	TArray<uint32> ClusterIndices;
+	TArray<uint32> ClusterMembers;
+
+	for (uint32 I = 0; I < Iterations; ++I)
+	{
+		int32 Op = Random.RandHelper(8);
+		if (Op <= 3)
+		{
+			uint32 SpawnCount = 1 + (uint32)Random.RandHelper(64);
+			for (uint32 J = 0; J < SpawnCount; ++J)
+			{
+				uint16 ConfigId = ConfigIds[Random.RandHelper(ConfigIds.Num())];
+				bool bAccepted = CanSpawn(Simulation, ConfigId);
+				FProjectileHandle Handle = Simulation.CreateProjectile(ConfigId, RandomSpawnLocation(Random), RandomSpawnRotation(Random));
+
+				PROJECTILE_TEST(Simulation.IsProjectileValid(Handle) == bAccepted);
+				if (bAccepted)
+				{
+					Live.Add(Handle);
+				}
+			}
+		}
+		else if (Op <= 5 && Live.Num() > 0)
+		{
+			uint32 DestroyCount = 1 + (uint32)Random.RandHelper(FMath::Min(Live.Num(), 32));
+			for (uint32 J = 0; J < DestroyCount; ++J)
+			{
+				int32 Pick = Random.RandHelper(Live.Num());
+				FProjectileHandle Handle = Live[Pick];
+
+				if (Random.RandHelper(4) == 0)
+				{
+					// promote/demote round trip, the projectile continues from the same state under a new handle
+					FProjectileState State;
+					uint16 ConfigId = 0;
+					uint16 OwnerId = 0;
+					PROJECTILE_TEST(Simulation.RemoveProjectile(Handle, EProjectileDestroyReason::Promoted, State, ConfigId, OwnerId));
+					PROJECTILE_TEST(!Simulation.IsProjectileValid(Handle));
+
+					// the freed handle may be all the headroom there is, a low priority demote is rejected then
+					bool bAccepted = CanSpawn(Simulation, ConfigId);
+					Live[Pick] = Simulation.CreateProjectileFromState(ConfigId, State, OwnerId);
+					PROJECTILE_TEST(Simulation.IsProjectileValid(Live[Pick]) == bAccepted);
+					if (!bAccepted)
+					{
+						Live.RemoveAtSwap(Pick);
+						continue;
+					}
+
+					PROJECTILE_TEST(Simulation.GetProjectileState(Live[Pick])->Position == State.Position);
+					PROJECTILE_TEST(Simulation.GetProjectileState(Live[Pick])->Lifetime == State.Lifetime);
+					continue;
+				}
+
+				Live.RemoveAtSwap(Pick);
+				Simulation.DestroyProjectile(Handle);
+				if (!bDeterministic)
+				{
+					PROJECTILE_TEST(!Simulation.IsProjectileValid(Handle));
+				}
+				Destroyed.Add(Handle);
+			}
+		}
+		else if (Op == 6)
+		{
+			// the index must find exactly what a brute force pass over the chunks finds
+			FVector Center = RandomSpawnLocation(Random);
+			float Radius = Random.FRandRange(100.0f, 10000.0f);
+			Simulation.QueryRadius(Center, Radius, QueryResult);
+
+			int32 Expected = 0;
+			for (const FProjectileChunk& Chunk : Simulation.Chunks)
+			{
+				for (uint32 J = 0; J < Chunk.Count; ++J)
+				{
+					Expected += FVector::DistSquared(Chunk.States[J].Position, Center) <= FMath::Square((double)Radius) ? 1 : 0;
+				}
+			}
+
+			PROJECTILE_TEST(QueryResult.Num() == Expected);
+			for (FProjectileHandle Handle : QueryResult)
+			{
+				PROJECTILE_TEST(Simulation.IsProjectileValid(Handle));
+				PROJECTILE_TEST(FVector::DistSquared(Simulation.GetProjectileState(Handle)->Position, Center) <= FMath::Square((double)Radius));
+			}
+			QueryResult.Reset();
+		}
+		else
+		{
+			// once handles are out a budget only grows the table, the invariants check they all stay valid
+			if (Live.Num() > 0 && Random.RandHelper(16) == 0)
+			{
+				uint32 HandleCount = Simulation.HandleTable.MaxCount;
+				PROJECTILE_TEST(Simulation.ReserveHandles(1) == HandleCount);
+				PROJECTILE_TEST(Simulation.ReserveHandles(HandleCount + 64) == FMath::Min(HandleCount + 64, (uint32)MAX_PROJECTILE_HANDLES));
+			}
+
+			Simulation.SetTargetLocation(TargetId, RandomSpawnLocation(Random));
+
+			// some of the cells with projectiles in them unload, the rest load again
+			if (Simulation.StreamingCellSize > 0.0f)
+			{
+				Simulation.UnloadedCells.Reset();
+				for (const FIntPoint& Cell : Simulation.OccupiedCells)
+				{
+					if (Random.RandHelper(4) == 0)
+					{
+						Simulation.UnloadedCells.Add(Cell);
+					}
+				}
+			}
+
+			float DeltaTime = bDeterministic ? Simulation.FixedTimestep : Random.FRandRange(0.001f, 0.1f);
+			if (Random.RandHelper(2) == 0)
+			{
+				Simulation.Tick(DeltaTime, -980.0f, World);
+			}
+			else
+			{
+				// the game thread keeps spawning while the sweep task runs, those wait for the next tick
+				Simulation.BeginTick(DeltaTime, -980.0f, World);
+
+				uint32 SpawnCount = (uint32)Random.RandHelper(16);
+				for (uint32 J = 0; J < SpawnCount; ++J)
+				{
+					uint16 ConfigId = ConfigIds[Random.RandHelper(ConfigIds.Num())];
+					bool bAccepted = CanSpawn(Simulation, ConfigId);
+					FProjectileHandle Handle = Simulation.CreateProjectile(ConfigId, RandomSpawnLocation(Random), RandomSpawnRotation(Random));
+
+					PROJECTILE_TEST(Simulation.IsProjectileValid(Handle) == bAccepted);
+					if (bAccepted)
+					{
+						Live.Add(Handle);
+					}
+				}
+
+				Simulation.SimulateTick();
+				Simulation.EndTick();
+			}
+
+			if (Simulation.bPublishSnapshots)
+			{
+				// published before the deferred destroys were flushed, so those may still be in it
+				FProjectileSnapshotReadScope Read(Simulation.Snapshots);
+				PROJECTILE_TEST(Read.Snapshot != nullptr);
+				PROJECTILE_TEST(Read.Snapshot->Positions.Num() == Read.Snapshot->Num());
+				PROJECTILE_TEST(Read.Snapshot->PrevPositions.Num() == Read.Snapshot->Num());
+				PROJECTILE_TEST(Read.Snapshot->Alpha >= 0.0f && Read.Snapshot->Alpha <= 1.0f);
+				for (FProjectileHandle Handle : Read.Snapshot->Handles)
+				{
+					PROJECTILE_TEST(Simulation.IsProjectileValid(Handle) || Destroyed.Contains(Handle));
+				}
+			}
+
+			// deferred destroys are flushed by the tick, whatever hit something is gone as well
+			for (FProjectileHandle Handle : Destroyed)
+			{
+				PROJECTILE_TEST(!Simulation.IsProjectileValid(Handle));
+			}
+			Destroyed.Reset();
+
+			Live.RemoveAllSwap([&Simulation](FProjectileHandle Handle)
+			{
+				return !Simulation.IsProjectileValid(Handle);
+			});
+
+			// every explosion lands in exactly one cluster of its config that contains it
+			ClusterProjectileExplosions(Simulation.Explosions, 1000.0f, Clusters, ClusterIndices, ClusterMembers);
+			uint32 MemberCount = 0;
+			for (const FProjectileExplosionCluster& Cluster : Clusters)
+			{
+				for (uint32 I = 0; I < Cluster.MemberCount; ++I)
+				{
+					const FProjectileExplosion& Explosion = Simulation.Explosions[ClusterMembers[Cluster.FirstMember + I]];
+					PROJECTILE_TEST(Explosion.ConfigId == Cluster.ConfigId && Explosion.OwnerId == Cluster.OwnerId);
+					PROJECTILE_TEST(FVector::Dist(Explosion.Location, Cluster.Center) + Explosion.Radius <= Cluster.Radius + 1.0f);
+				}
+				MemberCount += Cluster.MemberCount;
+			}
+			PROJECTILE_TEST(MemberCount == (uint32)Simulation.Explosions.Num());
+			Simulation.Explosions.Reset();
+		}
+
+		if (!CheckSimulationInvariants(Simulation))
+		{
+			return false;
+		}
+	}
+
+	OutHash = Simulation.StateHash;
+	return true;
+}
+
+/** prints the average of Fn over Count runs */
+template<typename FnType>
+static void RunBenchmark(const TCHAR* Name, uint32 Count, uint32 ItemsPerRun, FnType&& Fn)
+{
+	double Start = FPlatformTime::Seconds();
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		Fn();
+	}
+	double Elapsed = FPlatformTime::Seconds() - Start;
+
+	double MsPerRun = Elapsed * 1000.0 / (double)Count;
+	double NsPerItem = Elapsed * 1.0e9 / ((double)Count * (double)FMath::Max(ItemsPerRun, 1u));
+	UE_LOG(LogProjectileCoreTests, Display, TEXT("%-32s %10.4f ms/run %10.2f ns/item"), Name, MsPerRun, NsPerItem);
+}
+
+static void RunBenchmarks(int32 Seed, uint32 ProjectileCount, uint32 TickCount)
+{
+	ProjectileCount = FMath::Clamp(ProjectileCount, 1u, (uint32)MAX_PROJECTILE_HANDLES);
+	FRandomStream Random(Seed);
+
+	{
+		FHandleTable Table;
+		Table.Init(MAX_PROJECTILE_HANDLES);
+		TArray<FProjectileHandle> Handles;
+		Handles.Reserve(MAX_PROJECTILE_HANDLES);
+
+		RunBenchmark(TEXT("HandleTable Claim/Release"), 100, MAX_PROJECTILE_HANDLES, [&Table, &Handles]()
+		{
+			for (uint32 I = 0; I < MAX_PROJECTILE_HANDLES; ++I)
+			{
+				Handles.Add(Table.Claim());
+			}
+			for (FProjectileHandle Handle : Handles)
+			{
+				Table.Release(Handle);
+			}
+			Handles.Reset();
+		});
+	}
+
+	FProjectileStubCollisionWorld World;
+	BuildStubWorld(World, Random);
+
+	FProjectileSimulation Simulation;
+	Simulation.Init(MAX_PROJECTILE_HANDLES);
+
+	TArray<uint16> ConfigIds;
+	AddStubConfigs(Simulation, ConfigIds);
+	Simulation.AddTarget(RandomSpawnLocation(Random));
+
+	for (uint16 ConfigId : ConfigIds)
+	{
+		FProjectileSimParams& Params = Simulation.Configs[ConfigId];
+		Params.MaxLifetime = 0.0f;
+	}
+
+	TArray<FProjectileHandle> Handles;
+	Handles.Reserve(ProjectileCount);
+
+	RunBenchmark(TEXT("Simulation CreateProjectile"), 1, ProjectileCount, [&]()
+	{
+		for (uint32 I = 0; I < ProjectileCount; ++I)
+		{
+			Handles.Add(Simulation.CreateProjectile(ConfigIds[I % ConfigIds.Num()], RandomSpawnLocation(Random), RandomSpawnRotation(Random)));
+		}
+	});
+
+	// projectiles die on impact, keep the population topped up so every tick simulates the same amount
+	uint64 TracesBefore = World.TraceCount;
+	RunBenchmark(TEXT("Simulation Tick"), TickCount, ProjectileCount, [&]()
+	{
+		Simulation.Tick(1.0f / 60.0f, -980.0f, World);
+		Simulation.Explosions.Reset();
+
+		for (FProjectileHandle& Handle : Handles)
+		{
+			if (!Simulation.IsProjectileValid(Handle))
+			{
+				int32 ConfigIndex = (int32)(Handle.Index % (uint32)ConfigIds.Num());
+				Handle = Simulation.CreateProjectile(ConfigIds[ConfigIndex], RandomSpawnLocation(Random), RandomSpawnRotation(Random));
+			}
+		}
+	});
+	UE_LOG(LogProjectileCoreTests, Display, TEXT("%-32s %10.1f traces/tick"), TEXT("Simulation Tick"),
+		(double)(World.TraceCount - TracesBefore) / (double)FMath::Max(TickCount, 1u));
+
+	RunBenchmark(TEXT("SpatialIndex Build"), 100, ProjectileCount, [&]()
+	{
+		Simulation.SpatialIndex.Build(Simulation.Chunks.GetData(), (uint32)Simulation.Chunks.Num());
+	});
+
+	TArray<FProjectileHandle> QueryResult;
+	RunBenchmark(TEXT("SpatialIndex QueryRadius"), 1000, 1, [&]()
+	{
+		Simulation.QueryRadius(RandomSpawnLocation(Random), 2000.0f, QueryResult);
+		QueryResult.Reset();
+	});
+
+	RunBenchmark(TEXT("StubWorld TraceSegment"), 100000, 1, [&]()
+	{
+		FVector Start = RandomSpawnLocation(Random);
+		World.TraceSegment(Start, Start + Random.GetUnitVector() * 1000.0f, EProjectileTraceType::All);
+	});
+}
+
+/**
+ * Usage: ProjectileCoreTests [-Seed=N] [-Runs=N] [-Iterations=N] [-BenchCount=N] [-BenchTicks=N] [-NoFuzz] [-NoBench]
+ * Returns non-zero if any fuzz run failed. Every failure logs the seed it ran with
+ */
+INT32_MAIN_INT32_ARGC_TCHAR_ARGV()
+{
+	FTaskTagScope Scope(ETaskTag::EGameThread);
+	ON_SCOPE_EXIT
+	{
+		RequestEngineExit(TEXT("ProjectileCoreTests exiting"));
+		FEngineLoop::AppPreExit();
+		FModuleManager::Get().UnloadModulesAtShutdown();
+		FEngineLoop::AppExit();
+	};
+
+	if (int32 Ret = GEngineLoop.PreInit(ArgC, ArgV))
+	{
+		return Ret;
+	}
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	int32 Seed = 1337;
+	uint32 Runs = 32;
+	uint32 Iterations = 2000;
+	uint32 BenchCount = 10000;
+	uint32 BenchTicks = 300;
+	FParse::Value(CommandLine, TEXT("-Seed="), Seed);
+	FParse::Value(CommandLine, TEXT("-Runs="), Runs);
+	FParse::Value(CommandLine, TEXT("-Iterations="), Iterations);
+	FParse::Value(CommandLine, TEXT("-BenchCount="), BenchCount);
+	FParse::Value(CommandLine, TEXT("-BenchTicks="), BenchTicks);
+
+	uint32 Failures = 0;
+
+	if (!FParse::Param(CommandLine, TEXT("NoFuzz")))
+	{
+		double Start = FPlatformTime::Seconds();
+
+		for (uint32 Run = 0; Run < Runs; ++Run)
+		{
+			int32 RunSeed = Seed + (int32)Run;
+
+			if (!FuzzHandleTable(RunSeed, Iterations * 10))
+			{
+				UE_LOG(LogProjectileCoreTests, Error, TEXT("FuzzHandleTable failed with -Seed=%d"), RunSeed);
+				++Failures;
+			}
+
+			uint32 Hash = 0;
+			if (!FuzzSimulation(RunSeed, Iterations, false, Hash))
+			{
+				UE_LOG(LogProjectileCoreTests, Error, TEXT("FuzzSimulation failed with -Seed=%d"), RunSeed);
+				++Failures;
+			}
+
+			// the same seed must end up in the same state, twice
+			uint32 HashA = 0;
+			uint32 HashB = 0;
+			if (!FuzzSimulation(RunSeed, Iterations, true, HashA) || !FuzzSimulation(RunSeed, Iterations, true, HashB))
+			{
+				UE_LOG(LogProjectileCoreTests, Error, TEXT("FuzzSimulation (deterministic) failed with -Seed=%d"), RunSeed);
+				++Failures;
+			}
+			else if (HashA != HashB)
+			{
+				UE_LOG(LogProjectileCoreTests, Error, TEXT("Deterministic runs diverged (%08x != %08x) with -Seed=%d"), HashA, HashB, RunSeed);
+				++Failures;
+			}
+		}
+
+		UE_LOG(LogProjectileCoreTests, Display, TEXT("Fuzzed %u seeds in %.2fs, %u failed"), Runs, FPlatformTime::Seconds() - Start, Failures);
+	}
+
+	if (!FParse::Param(CommandLine, TEXT("NoBench")))
+	{
+		RunBenchmarks(Seed, BenchCount, BenchTicks);
+	}
+
+	return Failures > 0 ? 1 : 0;
+}
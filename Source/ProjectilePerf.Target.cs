@@ -9,6 +9,6 @@ public class ProjectilePerfTarget : TargetRules
 	{
 		Type = TargetType.Game;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
-		ExtraModuleNames.Add("ProjectilePerf");
+		ExtraModuleNames.AddRange(new string[] { "ProjectilePerf", "ProjectileCore" });
 	}
 }
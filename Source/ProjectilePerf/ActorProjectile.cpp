@@ -2,6 +2,8 @@
 
 #include "ActorProjectile.h"
 #include "ProjectileConfig.h"
+#include "ActorProjectilePool.h"
+#include "ProjectileSubsystem.h"
 
 // Engine
 #include "Components/SphereComponent.h"
@@ -37,27 +39,120 @@ void AActorProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Othe
 	Super::NotifyHit(MyComp, Other, OtherComp, bSelfMoved, HitLocation, HitNormal, NormalImpulse, Hit);
 
 	// destroy on impact
+	Expire();
+}
+
+void AActorProjectile::LifeSpanExpired()
+{
+	Expire();
+}
+
+void AActorProjectile::Expire()
+{
+	if (bPooled)
+	{
+		if (UActorProjectilePool* Pool = UActorProjectilePool::Get(GetWorld()))
+		{
+			Pool->Release(this);
+			return;
+		}
+	}
+
 	Destroy();
 }
 
+void AActorProjectile::Park()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AActorProjectile::Park);
+
+	bParked = true;
+
+	SetLifeSpan(0.0f);
+	SetActorTickEnabled(false);
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+}
+
+void AActorProjectile::Unpark(UProjectileConfig* InConfig, const FTransform& SpawnTM)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AActorProjectile::Unpark);
+
+	bParked = false;
+
+	SetActorTransform(SpawnTM, false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	InitFromConfig(InConfig);
+
+	// the movement component drops its updated component when it stops on a hit,
+	// and only applies InitialSpeed when it's initialized, so redo both
+	ProjectileMovement->SetUpdatedComponent(CollisionComponent);
+	ProjectileMovement->Velocity = SpawnTM.GetRotation().GetForwardVector() * Config->InitialSpeed;
+	ProjectileMovement->Activate(true);
+}
+
+void AActorProjectile::ContinueFromState(const FProjectileState& State)
+{
+	ProjectileMovement->Velocity = FVector(State.Velocity);
+
+	StartTime = GetWorld()->GetTimeSeconds() - State.Lifetime;
+	Bounces = State.Bounces;
+	Penetrations = State.Penetrations;
+
+	if (Config->MaxLifetime > 0.0f)
+	{
+		// whatever lifetime is left, a lifespan of 0 would mean forever
+		SetLifeSpan(FMath::Max(Config->MaxLifetime - State.Lifetime, UE_KINDA_SMALL_NUMBER));
+	}
+}
+
+FProjectileState AActorProjectile::GetProjectileState() const
+{
+	FProjectileState State = {};
+	State.Position = GetActorLocation();
+	State.Rotation = FRotator3f(GetActorRotation());
+	State.Velocity = FVector3f(ProjectileMovement->Velocity);
+	State.Lifetime = GetWorld()->GetTimeSeconds() - StartTime;
+	State.Bounces = Bounces;
+	State.Penetrations = Penetrations;
+	return State;
+}
+
 void AActorProjectile::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
 #if ENABLE_DRAW_DEBUG
-	DrawDebugLine(GetWorld(), GetActorLocation(), PrevLocation, FColor::Red, false, 1.0f);
+	// batched with the actorless projectiles, sampled the same way by a stable id
+	if (GetUniqueID() % (uint32)FMath::Max(Config->DebugSampleRate, 1) == 0)
+	{
+		if (UProjectileSubsystem* Subsystem = GetWorld()->GetSubsystem<UProjectileSubsystem>())
+		{
+			Subsystem->DrawActorDebugLine(PrevLocation, GetActorLocation(), Config->DebugColor);
+		}
+	}
 #endif // ENABLE_DRAW_DEBUG
 
 	PrevLocation = GetActorLocation();
 }
 
-void AActorProjectile::InitFromConfig(UProjectileConfig* Config)
+void AActorProjectile::InitFromConfig(UProjectileConfig* InConfig)
 {
+	Config = InConfig;
+	StartTime = GetWorld()->GetTimeSeconds();
+	Bounces = 0;
+	Penetrations = 0;
+
 	SetActorTickEnabled(Config->bDebugDraw);
 	PrevLocation = GetActorLocation();
 
 	ProjectileMovement->InitialSpeed = Config->InitialSpeed;
-	ProjectileMovement->MaxSpeed = Config->InitialSpeed;
+	ProjectileMovement->MaxSpeed = Config->bClampToInitialSpeed ? Config->InitialSpeed : 0.0f;
+	ProjectileMovement->ProjectileGravityScale = Config->GravityScale;
 	ProjectileMovement->bRotationFollowsVelocity = Config->bRotationFollowsVelocity;
 
 	SetLifeSpan(Config->MaxLifetime);
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "ProjectileSimulation.h"
 #include "ActorProjectile.generated.h"
 
 class UProjectileMovementComponent;
@@ -31,7 +32,17 @@ public:
 	//UPROPERTY()
 	//UNiagaraComponent* NiagaraComponent;
 
+	/** Config the projectile was last initialized with */
+	UPROPERTY()
+	UProjectileConfig* Config;
+
 	FVector PrevLocation = {};
+	float StartTime = 0.0f;			// world time the projectile started flying, earlier if it was promoted
+	uint8 Bounces = 0;				// carried over from the actorless state, so demoting gives them back
+	uint8 Penetrations = 0;
+
+	uint8 bPooled:1 = false;	// owned by UActorProjectilePool, returned to it instead of being destroyed
+	uint8 bParked:1 = false;	// sitting in the pool, inactive
 
 	AActorProjectile(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
@@ -40,7 +51,20 @@ public:
 		class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation,
 		FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit) override;
 	virtual void Tick(float DeltaTime) override;
+	virtual void LifeSpanExpired() override;
 	// ~ end AActor interface
 
-	void InitFromConfig(UProjectileConfig* Config);
+	void InitFromConfig(UProjectileConfig* InConfig);
+
+	/** hit something or ran out of lifetime. goes back to the pool when pooled */
+	void Expire();
+	/** deactivates everything so the actor costs nothing while in the pool */
+	void Park();
+	/** reactivates a parked actor and fires it from SpawnTM */
+	void Unpark(UProjectileConfig* InConfig, const FTransform& SpawnTM);
+
+	/** continue the flight of an actorless projectile. call after InitFromConfig/Unpark */
+	void ContinueFromState(const FProjectileState& State);
+	/** the current flight as an actorless state */
+	FProjectileState GetProjectileState() const;
 };
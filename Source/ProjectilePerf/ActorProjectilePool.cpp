@@ -0,0 +1,107 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ActorProjectilePool.h"
+#include "ActorProjectile.h"
+
+FActorProjectilePoolBucket& UActorProjectilePool::GetBucket(UClass* Class)
+{
+	if (FActorProjectilePoolBucket* Bucket = Buckets.Find(Class))
+	{
+		return *Bucket;
+	}
+
+	FActorProjectilePoolBucket& Bucket = Buckets.Add(Class);
+	const int32* MaxParked = MaxParkedPerClass.Find(TSoftClassPtr<AActorProjectile>(Class));
+	Bucket.MaxParked = MaxParked ? *MaxParked : DefaultMaxParked;
+	return Bucket;
+}
+
+AActorProjectile* UActorProjectilePool::SpawnParked(UClass* Class)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UActorProjectilePool::SpawnParked);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.bDeferConstruction = true;
+
+	AActorProjectile* Actor = GetWorld()->SpawnActor<AActorProjectile>(Class, FTransform::Identity, SpawnParams);
+	Actor->bPooled = true;
+	Actor->FinishSpawning(FTransform::Identity);
+	Actor->Park();
+
+	++SpawnedCount;
+	return Actor;
+}
+
+void UActorProjectilePool::Prewarm(TSubclassOf<AActorProjectile> Class, int32 Count)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UActorProjectilePool::Prewarm);
+
+	FActorProjectilePoolBucket& Bucket = GetBucket(Class);
+	int32 PrewarmCount = FMath::Min(Count, Bucket.MaxParked) - Bucket.Parked.Num();
+
+	Bucket.Parked.Reserve(Bucket.Parked.Num() + FMath::Max(PrewarmCount, 0));
+	for (int32 I = 0; I < PrewarmCount; ++I)
+	{
+		Bucket.Parked.Add(SpawnParked(Class));
+	}
+}
+
+AActorProjectile* UActorProjectilePool::Acquire(TSubclassOf<AActorProjectile> Class, UProjectileConfig* Config,
+	const FTransform& SpawnTM, AActor* Owner)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UActorProjectilePool::Acquire);
+
+	FActorProjectilePoolBucket& Bucket = GetBucket(Class);
+
+	AActorProjectile* Actor = nullptr;
+	while (Bucket.Parked.Num() > 0 && !Actor)
+	{
+		// parked actors can still be destroyed from the outside, level streaming etc
+		Actor = Bucket.Parked.Pop(false);
+		Actor = IsValid(Actor) ? Actor : nullptr;
+	}
+
+	if (Actor)
+	{
+		++ReusedCount;
+	}
+	else
+	{
+		Actor = SpawnParked(Class);
+	}
+
+	Actor->SetOwner(Owner);
+	Actor->Unpark(Config, SpawnTM);
+	return Actor;
+}
+
+void UActorProjectilePool::Release(AActorProjectile* Projectile)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UActorProjectilePool::Release);
+
+	if (!IsValid(Projectile) || Projectile->bParked)
+	{
+		return;
+	}
+
+	FActorProjectilePoolBucket& Bucket = GetBucket(Projectile->GetClass());
+	if (Bucket.Parked.Num() < Bucket.MaxParked)
+	{
+		Projectile->Park();
+		Bucket.Parked.Add(Projectile);
+	}
+	else
+	{
+		Projectile->bPooled = false;
+		Projectile->Destroy();
+	}
+}
+
+void UActorProjectilePool::Deinitialize()
+{
+	// the world destroys the actors themselves
+	Buckets.Reset();
+
+	Super::Deinitialize();
+}
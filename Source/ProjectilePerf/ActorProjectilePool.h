@@ -0,0 +1,70 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorProjectilePool.generated.h"
+
+class AActorProjectile;
+class UProjectileConfig;
+
+/** Parked projectiles of one class */
+USTRUCT()
+struct FActorProjectilePoolBucket
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActorProjectile>> Parked;
+
+	int32 MaxParked = 0;	// released projectiles past this are destroyed instead of parked
+};
+
+/**
+ * Keeps deactivated AActorProjectile instances around and reuses them instead of spawning new ones.
+ * Parked actors are hidden, have no collision and their movement is deactivated
+ */
+UCLASS(Config=Game)
+class PROJECTILEPERF_API UActorProjectilePool : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Max number of parked projectiles per class, for classes not in MaxParkedPerClass */
+	UPROPERTY(Config)
+	int32 DefaultMaxParked = 1024;
+
+	/** Max number of parked projectiles per class */
+	UPROPERTY(Config)
+	TMap<TSoftClassPtr<AActorProjectile>, int32> MaxParkedPerClass;
+
+	UPROPERTY(Transient)
+	TMap<TObjectPtr<UClass>, FActorProjectilePoolBucket> Buckets;
+
+	int32 SpawnedCount = 0;		// actors spawned because the pool was empty
+	int32 ReusedCount = 0;		// actors taken out of the pool
+
+	static UActorProjectilePool* Get(const UWorld* World)
+	{
+		return UWorld::GetSubsystem<UActorProjectilePool>(World);
+	}
+
+	/** spawns Count parked projectiles up front so acquiring them later is cheap. limited by the class cap */
+	void Prewarm(TSubclassOf<AActorProjectile> Class, int32 Count);
+
+	/** takes a parked projectile, or spawns one if there are none, and fires it from SpawnTM */
+	AActorProjectile* Acquire(TSubclassOf<AActorProjectile> Class, UProjectileConfig* Config,
+		const FTransform& SpawnTM, AActor* Owner);
+
+	/** parks the projectile for reuse, or destroys it if the pool for its class is full */
+	void Release(AActorProjectile* Projectile);
+
+	// ~ begin USubsystem interface
+	virtual void Deinitialize() override;
+	// ~ end USubsystem interface
+
+	FActorProjectilePoolBucket& GetBucket(UClass* Class);
+	AActorProjectile* SpawnParked(UClass* Class);
+};
@@ -0,0 +1,207 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "MassProjectileSubsystem.h"
+#include "ProjectileConfig.h"
+
+// Engine
+#include "MassEntitySubsystem.h"
+#include "MassExecutionContext.h"
+#include "MassExecutor.h"
+#include "MassCommandBuffer.h"
+
+UMassProjectileProcessor::UMassProjectileProcessor()
+	: EntityQuery(*this)
+{
+	// run explicitly by UMassProjectileSubsystem, there is no Mass simulation ticking the phases in this project
+	bAutoRegisterWithProcessingPhases = false;
+}
+
+void UMassProjectileProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FMassProjectileFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddConstSharedRequirement<FMassProjectileConfigFragment>();
+}
+
+void UMassProjectileProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassProjectileProcessor::Execute);
+
+	UWorld* World = GetWorld();
+	float DeltaTime = Context.GetDeltaTimeSeconds();
+	float GravityZ = World->GetGravityZ();
+
+	// same substeps as the actorless simulation so the comparison is fair
+	uint32 SubstepCount = (uint32)FMath::CeilToInt(DeltaTime / MAX_PROJECTILE_TIMESTEP);
+	SubstepCount = FMath::Clamp<uint32>(SubstepCount, 1, MAX_PROJECTILE_SUBSTEP);
+	float StepDt = DeltaTime / (float)SubstepCount;
+
+	Collision.World = World;
+
+	EntityQuery.ForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& ChunkContext)
+	{
+		TArrayView<FMassProjectileFragment> Projectiles = ChunkContext.GetMutableFragmentView<FMassProjectileFragment>();
+		const FProjectileSimParams& Config = ChunkContext.GetConstSharedFragment<FMassProjectileConfigFragment>().Params;
+
+		FVector3f ConstantAcc = FVector3f(0.0f, 0.0f, GravityZ * Config.GravityScale) + Config.Wind;
+
+		for (int32 I = 0; I < ChunkContext.GetNumEntities(); ++I)
+		{
+			FProjectileState& State = Projectiles[I].State;
+
+			for (uint32 Step = 0; Step < SubstepCount; ++Step)
+			{
+				// v = v0 + a*t
+				FVector3f V0 = State.Velocity;
+				FVector3f V1 = V0 + ConstantAcc * StepDt;
+				V1 -= V0 * (Config.DragCoefficient * V0.Size() * StepDt);
+				if (Config.MaxSpeed > 0.0f)
+				{
+					V1 = V1.GetClampedToMaxSize(Config.MaxSpeed);
+				}
+
+				// p = p0 + v0*t + 1/2*a*t^2
+				FVector Start = State.Position;
+				FVector End = Start + FVector(V0 * StepDt + (V1 - V0) * (0.5f * StepDt));
+
+				FProjectileHit Hit = Collision.TraceSegment(Start, End, EProjectileTraceType::All);
+				bool bHit = Hit.bBlockingHit || Hit.bStartPenetrating;
+
+				State.Position = Start + (End - Start) * Hit.Time;
+				State.Velocity = V1;
+				State.Lifetime += StepDt;
+
+				if (Config.bRotationFollowsVelocity)
+				{
+					State.Rotation = V1.Rotation();
+				}
+
+				if (bHit || (Config.MaxLifetime != 0.0f && State.Lifetime >= Config.MaxLifetime))
+				{
+					// destroyed when the executor flushes the commands
+					ChunkContext.Defer().DestroyEntity(ChunkContext.GetEntity(I));
+					break;
+				}
+			}
+		}
+	});
+}
+
+void FMassProjectileTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType,
+	ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	Subsystem->Tick(DeltaTime);
+}
+
+UMassProjectileSubsystem::UMassProjectileSubsystem()
+	: Super()
+{
+	TickFunction.Subsystem = this;
+	TickFunction.bCanEverTick = true;
+	TickFunction.bStartWithTickEnabled = true;
+	TickFunction.TickGroup = TG_PrePhysics;
+}
+
+FMassEntityManager& UMassProjectileSubsystem::GetEntityManager() const
+{
+	UMassEntitySubsystem* EntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
+	check(EntitySubsystem);
+	return EntitySubsystem->GetMutableEntityManager();
+}
+
+const FMassArchetypeSharedFragmentValues& UMassProjectileSubsystem::GetConfigSharedValues(UProjectileConfig* Config)
+{
+	if (const FMassArchetypeSharedFragmentValues* Found = ConfigSharedValues.Find(Config))
+	{
+		return *Found;
+	}
+
+	// entities with different shared values never share a Mass chunk,
+	// so every chunk runs a single config like the actorless chunks do
+	FMassProjectileConfigFragment Fragment;
+	Fragment.Params = Config->GetSimParams();
+
+	FMassArchetypeSharedFragmentValues& SharedValues = ConfigSharedValues.Add(Config);
+	SharedValues.AddConstSharedFragment(FConstSharedStruct::Make(Fragment));
+	SharedValues.Sort();
+	return SharedValues;
+}
+
+FMassEntityHandle UMassProjectileSubsystem::CreateProjectile(UProjectileConfig* Config, const FVector& Location, const FRotator& Rotation)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassProjectileSubsystem::CreateProjectile);
+
+	FMassEntityManager& EntityManager = GetEntityManager();
+	FMassEntityHandle Entity = EntityManager.CreateEntity(Archetype, GetConfigSharedValues(Config));
+
+	FProjectileState& State = EntityManager.GetFragmentDataChecked<FMassProjectileFragment>(Entity).State;
+	State = {};
+	State.Position = Location;
+	State.Rotation = FRotator3f(Rotation);
+	State.Velocity = FRotator3f(Rotation).Vector() * Config->InitialSpeed;
+	return Entity;
+}
+
+void UMassProjectileSubsystem::DestroyProjectile(FMassEntityHandle Entity)
+{
+	FMassEntityManager& EntityManager = GetEntityManager();
+	if (EntityManager.IsEntityValid(Entity))
+	{
+		EntityManager.DestroyEntity(Entity);
+	}
+}
+
+FProjectileState* UMassProjectileSubsystem::GetProjectileState(FMassEntityHandle Entity)
+{
+	FMassEntityManager& EntityManager = GetEntityManager();
+	if (!EntityManager.IsEntityValid(Entity))
+	{
+		// same as the actorless projectiles, callers get something to write to without error checking.
+		// IsProjectileValid is for the actual error handling
+		static FProjectileState GStubState;
+		return &GStubState;
+	}
+
+	return &EntityManager.GetFragmentDataChecked<FMassProjectileFragment>(Entity).State;
+}
+
+bool UMassProjectileSubsystem::IsProjectileValid(FMassEntityHandle Entity) const
+{
+	return GetEntityManager().IsEntityValid(Entity);
+}
+
+void UMassProjectileSubsystem::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UMassProjectileSubsystem::Tick);
+
+	FMassProcessingContext ProcessingContext(GetEntityManager(), DeltaTime);
+	UE::Mass::Executor::Run(*Processor, ProcessingContext);
+}
+
+void UMassProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	Collection.InitializeDependency<UMassEntitySubsystem>();
+
+	FMassEntityManager& EntityManager = GetEntityManager();
+	Archetype = EntityManager.CreateArchetype({ FMassProjectileFragment::StaticStruct(), FMassProjectileConfigFragment::StaticStruct() });
+
+	Processor = NewObject<UMassProjectileProcessor>(this);
+	Processor->CallInitialize(this);
+}
+
+void UMassProjectileSubsystem::Deinitialize()
+{
+	TickFunction.UnRegisterTickFunction();
+	ConfigSharedValues.Reset();
+	Processor = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UMassProjectileSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	if (InWorld.IsGameWorld())
+	{
+		TickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+	}
+}
@@ -0,0 +1,133 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "MassEntityQuery.h"
+#include "MassProcessor.h"
+#include "ProjectileSimulation.h"
+#include "ProjectileSubsystem.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MassProjectileSubsystem.generated.h"
+
+class UProjectileConfig;
+class UMassProjectileSubsystem;
+struct FMassEntityManager;
+
+/** Per-entity state, the same data an actorless projectile keeps */
+USTRUCT()
+struct FMassProjectileFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FProjectileState	State;
+};
+
+/** Config shared by every projectile entity in a Mass chunk, like FProjectileChunk::ConfigId */
+USTRUCT()
+struct FMassProjectileConfigFragment : public FMassConstSharedFragment
+{
+	GENERATED_BODY()
+
+	FProjectileSimParams Params;
+};
+
+/**
+ * Integrates and traces projectile entities, the Mass version of the simulation kernels.
+ * Only gravity, wind, drag, max speed, rotation and lifetime, anything that hits is destroyed
+ */
+UCLASS()
+class PROJECTILEPERF_API UMassProjectileProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+
+	UMassProjectileProcessor();
+
+protected:
+
+	// ~ begin UMassProcessor interface
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+	// ~ end UMassProcessor interface
+
+	FMassEntityQuery EntityQuery;
+	FProjectileWorldCollision Collision;	// traces with the same channel and query params as the actorless projectiles
+};
+
+/** Runs the Mass projectile processor once per frame */
+USTRUCT()
+struct FMassProjectileTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UMassProjectileSubsystem* Subsystem;
+
+	// ~ begin FTickFunction interface
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread,
+		const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override { return TEXT("FMassProjectileTickFunction"); }
+	// ~ end FTickFunction interface
+};
+
+template<>
+struct TStructOpsTypeTraits<FMassProjectileTickFunction>
+	: public TStructOpsTypeTraitsBase2<FMassProjectileTickFunction>
+{
+	enum { WithCopy = false };
+};
+
+/**
+ * Actorless projectiles as Mass entities, a third backend next to actors and UProjectileSubsystem
+ * with the same create/destroy/state surface so the three can be benchmarked under the same load
+ */
+UCLASS()
+class PROJECTILEPERF_API UMassProjectileSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	UMassProjectileSubsystem();
+
+	static UMassProjectileSubsystem* Get(const UWorld* World)
+	{
+		return UWorld::GetSubsystem<UMassProjectileSubsystem>(World);
+	}
+
+	/** spawns a new projectile entity */
+	FMassEntityHandle CreateProjectile(UProjectileConfig* Config, const FVector& Location, const FRotator& Rotation);
+	/** destroys the projectile entity. cannot be called from inside the processor */
+	void DestroyProjectile(FMassEntityHandle Entity);
+	/** gets the state of a projectile entity. will return a stub if the entity is gone so the code works,
+		same as UProjectileSubsystem::GetProjectileState. use IsProjectileValid for actual error handling */
+	FProjectileState* GetProjectileState(FMassEntityHandle Entity);
+	/** test if the handle refers to a live projectile entity */
+	bool IsProjectileValid(FMassEntityHandle Entity) const;
+
+	void Tick(float DeltaTime);
+
+	// ~ begin USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// ~ end USubsystem interface
+
+	// ~ begin UWorldSubsystem interface
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	// ~ end UWorldSubsystem interface
+
+private:
+
+	FMassEntityManager& GetEntityManager() const;
+	const FMassArchetypeSharedFragmentValues& GetConfigSharedValues(UProjectileConfig* Config);
+
+	UPROPERTY(Transient)
+	TObjectPtr<UMassProjectileProcessor> Processor;
+
+	FMassArchetypeHandle		Archetype;
+	TMap<UProjectileConfig*, FMassArchetypeSharedFragmentValues> ConfigSharedValues;	// one shared config fragment per config
+
+	FMassProjectileTickFunction	TickFunction;
+};
@@ -3,3 +3,80 @@
 
 #include "ProjectileConfig.h"
 
+FProjectileSimParams UProjectileConfig::GetSimParams() const
+{
+	FProjectileSimParams Params = {};
+	Params.InitialSpeed = InitialSpeed;
+	Params.MaxSpeed = bClampToInitialSpeed ? InitialSpeed : 0.0f;
+	Params.MaxLifetime = MaxLifetime;
+	Params.GravityScale = GravityScale;
+	Params.DragCoefficient = DragCoefficient;
+	Params.Wind = FVector3f(Wind);
+	Params.MaxBounces = (uint8)FMath::Clamp(MaxBounces, 0, 255);
+	Params.MaxPenetrations = (uint8)FMath::Clamp(MaxPenetrations, 0, 255);
+	Params.Restitution = Restitution;
+	Params.BounceFriction = BounceFriction;
+	Params.MinBounceSpeed = MinBounceSpeed;
+	Params.PenetrationSpeedRetention = PenetrationSpeedRetention;
+
+	static_assert(SurfaceType_Max <= MAX_PROJECTILE_SURFACE_TYPES);
+	for (int32 I = 0; I < MAX_PROJECTILE_SURFACE_TYPES; ++I)
+	{
+		Params.PenetrationDepth[I] = DefaultPenetrationDepth;
+	}
+	for (const TPair<TEnumAsByte<EPhysicalSurface>, float>& Pair : PenetrationDepthBySurface)
+	{
+		Params.PenetrationDepth[Pair.Key.GetValue()] = Pair.Value;
+	}
+
+	Params.TurnRate = FMath::DegreesToRadians(TurnRate);
+	Params.AcquisitionCosHalfAngle = FMath::Cos(FMath::DegreesToRadians(AcquisitionConeHalfAngle));
+	Params.AcquisitionRange = AcquisitionRange;
+	Params.bHoming = bHoming;
+	Params.LookaheadDistance = LookaheadDistance;
+	Params.LookaheadTolerance = LookaheadTolerance;
+	Params.TraceErrorTolerance = TraceErrorTolerance;
+	Params.ExplosionRadius = bExplosive ? ExplosionOuterRadius : 0.0f;
+
+	switch (UnloadedPolicy)
+	{
+	case EProjectileConfigUnloadedPolicy::Freeze:		Params.UnloadedPolicy = EProjectileUnloadedPolicy::Freeze; break;
+	case EProjectileConfigUnloadedPolicy::Ballistic:	Params.UnloadedPolicy = EProjectileUnloadedPolicy::Ballistic; break;
+	case EProjectileConfigUnloadedPolicy::Expire:		Params.UnloadedPolicy = EProjectileUnloadedPolicy::Expire; break;
+	default:											Params.UnloadedPolicy = EProjectileUnloadedPolicy::Simulate; break;
+	}
+
+	Params.Priority = (uint8)FMath::Clamp(Priority, 0, 255);
+
+	switch (SaturationPolicy)
+	{
+	case EProjectileConfigSaturationPolicy::EvictOldest:	Params.SaturationPolicy = EProjectileSaturationPolicy::EvictOldest; break;
+	case EProjectileConfigSaturationPolicy::EvictFarthest:	Params.SaturationPolicy = EProjectileSaturationPolicy::EvictFarthest; break;
+	default:												Params.SaturationPolicy = EProjectileSaturationPolicy::Reject; break;
+	}
+
+	Params.bRotationFollowsVelocity = bRotationFollowsVelocity;
+	Params.bDebugDraw = bDebugDraw;
+	Params.DebugColor = DebugColor;
+	Params.DebugSampleRate = (uint16)FMath::Clamp(DebugSampleRate, 1, (int32)MAX_uint16);
+	Params.MaxDebugLines = (uint32)FMath::Max(MaxDebugLines, 0);
+	return Params;
+}
+
+float UProjectileConfig::GetExplosionDamage(float Distance) const
+{
+	if (Distance > ExplosionOuterRadius)
+	{
+		return 0.0f;
+	}
+
+	// same falloff as UGameplayStatics::ApplyRadialDamageWithFalloff
+	float Scale = 1.0f;
+	if (Distance > ExplosionInnerRadius && ExplosionOuterRadius > ExplosionInnerRadius)
+	{
+		Scale = 1.0f - (Distance - ExplosionInnerRadius) / (ExplosionOuterRadius - ExplosionInnerRadius);
+		Scale = FMath::Pow(Scale, ExplosionDamageFalloff);
+	}
+
+	return FMath::Lerp(ExplosionMinimumDamage, ExplosionBaseDamage, Scale);
+}
@@ -4,9 +4,39 @@
 
 #include "CoreMinimal.h"
 #include "Engine/DataAsset.h"
+#include "Chaos/ChaosEngineInterface.h"
+#include "ProjectileSimulation.h"
 #include "ProjectileConfig.generated.h"
 
 class UNiagaraSystem;
+class UDamageType;
+
+/** What projectiles do while the world partition cell they are in isn't loaded, see EProjectileUnloadedPolicy */
+UENUM()
+enum class EProjectileConfigUnloadedPolicy : uint8
+{
+	/** Keep simulating as usual, misses everything that isn't loaded */
+	Simulate,
+	/** Stay where they are until the cell loads, lifetime doesn't run out */
+	Freeze,
+	/** Keep moving without tracing until the cell loads */
+	Ballistic,
+	/** Destroyed right away */
+	Expire,
+};
+
+/** What projectiles below UProjectileSubsystem::ReservedPriority do once there is no headroom left, see EProjectileSaturationPolicy.
+	New spawns are rejected either way */
+UENUM()
+enum class EProjectileConfigSaturationPolicy : uint8
+{
+	/** The ones in flight keep flying */
+	Reject,
+	/** The ones in flight are destroyed to make room, oldest first */
+	EvictOldest,
+	/** The ones in flight are destroyed to make room, farthest from any player first */
+	EvictFarthest,
+};
 
 /**
  * Configuration for a projectile type
@@ -21,12 +51,152 @@ public:
 	UPROPERTY(EditAnywhere, Meta=(UIMin="1.0", ClampMin="1.0", ForceUnits="cm/s"))
 	float InitialSpeed = 2000.f;
 
+	/** Never go faster than InitialSpeed, even when falling */
+	UPROPERTY(EditAnywhere)
+	uint8 bClampToInitialSpeed:1 = true;
+
+	/** Multiplier for the world gravity, 0 flies straight */
+	UPROPERTY(EditAnywhere)
+	float GravityScale = 1.f;
+
+	/** Quadratic air drag, deceleration is DragCoefficient * speed^2 */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0"))
+	float DragCoefficient = 0.f;
+
+	/** Constant acceleration applied by wind, in cm/s^2 */
+	UPROPERTY(EditAnywhere)
+	FVector Wind = FVector::ZeroVector;
+
 	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", ForceUnits="s"))
 	float MaxLifetime = 10.f;
 
+	/** Number of times the projectile ricochets off surfaces it can't go through. 0 is destroyed on the first hit */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0", ClampMin="0", UIMax="255", ClampMax="255"))
+	int32 MaxBounces = 0;
+
+	/** Fraction of the velocity into the surface that is kept when bouncing */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", UIMax="1.0", ClampMax="1.0"))
+	float Restitution = 0.6f;
+
+	/** Fraction of the velocity along the surface that is lost when bouncing */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", UIMax="1.0", ClampMax="1.0"))
+	float BounceFriction = 0.2f;
+
+	/** Projectiles slower than this are destroyed on impact instead of bouncing */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", ForceUnits="cm/s"))
+	float MinBounceSpeed = 100.f;
+
+	/** Number of surfaces the projectile can go through */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0", ClampMin="0", UIMax="255", ClampMax="255"))
+	int32 MaxPenetrations = 0;
+
+	/** Thickest surface the projectile can go through, for surface types not in PenetrationDepthBySurface */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float DefaultPenetrationDepth = 0.f;
+
+	/** Thickest surface the projectile can go through, per physical surface type */
+	UPROPERTY(EditAnywhere)
+	TMap<TEnumAsByte<EPhysicalSurface>, float> PenetrationDepthBySurface;
+
+	/** Fraction of the velocity kept after going through a surface */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", UIMax="1.0", ClampMax="1.0"))
+	float PenetrationSpeedRetention = 0.7f;
+
+	/** Steer towards the closest registered target (UProjectileTargetComponent) in the acquisition cone */
+	UPROPERTY(EditAnywhere)
+	uint8 bHoming:1 = false;
+
+	/** How fast a homing projectile can turn */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bHoming", UIMin="0.0", ClampMin="0.0", ForceUnits="deg/s"))
+	float TurnRate = 90.f;
+
+	/** Targets further off the projectile heading than this are ignored */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bHoming", UIMin="0.0", ClampMin="0.0", UIMax="180.0", ClampMax="180.0", ForceUnits="deg"))
+	float AcquisitionConeHalfAngle = 30.f;
+
+	/** Targets further away than this are ignored */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bHoming", UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float AcquisitionRange = 5000.f;
+
+	/** Live projectiles of this config expected at the same time. Room for this many is allocated when the level
+		starts, so the first volley doesn't allocate. 0 allocates on demand. once every config has one the handle table
+		is sized to their sum instead of the full MAX_PROJECTILE_HANDLES */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0", ClampMin="0"))
+	int32 ExpectedPeakCount = 0;
+
+	/** Lower priorities are rejected and evicted first when the projectile budget runs out.
+		Configs at or above UProjectileSubsystem::ReservedPriority are never rejected before the budget is gone */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0", ClampMin="0", UIMax="255", ClampMax="255"))
+	int32 Priority = 0;
+
+	UPROPERTY(EditAnywhere)
+	EProjectileConfigSaturationPolicy SaturationPolicy = EProjectileConfigSaturationPolicy::Reject;
+
+	/** Deal radial damage when destroyed by a hit. Explosions landing close together share one overlap query */
+	UPROPERTY(EditAnywhere)
+	uint8 bExplosive:1 = false;
+
+	/** Damage at and within ExplosionInnerRadius */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bExplosive", UIMin="0.0", ClampMin="0.0"))
+	float ExplosionBaseDamage = 100.f;
+
+	/** Damage at ExplosionOuterRadius */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bExplosive", UIMin="0.0", ClampMin="0.0"))
+	float ExplosionMinimumDamage = 0.f;
+
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bExplosive", UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float ExplosionInnerRadius = 0.f;
+
+	/** Nothing further away than this is damaged */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bExplosive", UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float ExplosionOuterRadius = 300.f;
+
+	/** Exponent of the falloff between the inner and outer radius, 1 is linear */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bExplosive", UIMin="0.0", ClampMin="0.0"))
+	float ExplosionDamageFalloff = 1.f;
+
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bExplosive"))
+	TSubclassOf<UDamageType> ExplosionDamageType;
+
+	/** damage an explosion does at Distance from its center */
+	float GetExplosionDamage(float Distance) const;
+
+	/** Trace static geometry this far ahead once and only check dynamic objects until the projectile
+		gets there, instead of tracing everything every step. 0 traces everything every step */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float LookaheadDistance = 0.f;
+
+	/** How far a projectile can drift off its lookahead (gravity, homing) before static geometry is traced again */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float LookaheadTolerance = 1.f;
+
+	/** How far the trajectory may bend away from a trace before it's split up. Nearly straight projectiles trace
+		a whole frame at once, lobbed ones several times, integration still runs every substep.
+		0 traces every substep. Not used with a LookaheadDistance, drag or a MaxSpeed */
+	UPROPERTY(EditAnywhere, Meta=(UIMin="0.0", ClampMin="0.0", ForceUnits="cm"))
+	float TraceErrorTolerance = 0.f;
+
+	/** What happens in world partition cells that aren't loaded, only with UProjectileSubsystem::bStreamingAware */
+	UPROPERTY(EditAnywhere)
+	EProjectileConfigUnloadedPolicy UnloadedPolicy = EProjectileConfigUnloadedPolicy::Ballistic;
+
 	UPROPERTY(EditAnywhere)
 	uint8 bRotationFollowsVelocity:1 = true;
 
 	UPROPERTY(EditAnywhere)
 	uint8 bDebugDraw:1 = false;
+
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bDebugDraw"))
+	FColor DebugColor = FColor::Green;
+
+	/** Only every Nth projectile is drawn, keeps debug drawing cheap with a lot of projectiles in flight */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bDebugDraw", UIMin="1", ClampMin="1"))
+	int32 DebugSampleRate = 1;
+
+	/** Projectiles of this config drawn per frame, 0 is no limit */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="bDebugDraw", UIMin="0", ClampMin="0"))
+	int32 MaxDebugLines = 0;
+
+	/** the engine agnostic part of the config the simulation runs with */
+	FProjectileSimParams GetSimParams() const;
 };
@@ -3,5 +3,7 @@
 #include "ProjectilePerf.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogProjectile);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ProjectilePerf, "ProjectilePerf" );
  
\ No newline at end of file
@@ -0,0 +1,445 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileRecorder.h"
+#include "ProjectileSubsystem.h"
+#include "ProjectileConfig.h"
+#include "ProjectilePerf.h"
+
+// Engine
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+
+#define PROJECTILE_RECORDING_MAGIC (0x524A5250) // PRJR
+#define PROJECTILE_RECORDING_FRAME_MAGIC (0x4D524650) // PFRM
+#define PROJECTILE_RECORDING_VERSION (1)
+// every section inside a frame starts at this alignment
+#define PROJECTILE_RECORDING_ALIGNMENT (8)
+
+static_assert(sizeof(FProjectileRecordingFileHeader) % PROJECTILE_RECORDING_ALIGNMENT == 0);
+static_assert(sizeof(FProjectileRecordingFrameHeader) % PROJECTILE_RECORDING_ALIGNMENT == 0);
+static_assert(sizeof(FProjectileRecordedConfig) % PROJECTILE_RECORDING_ALIGNMENT == 0);
+static_assert(sizeof(FProjectileRecordedSpawn) % PROJECTILE_RECORDING_ALIGNMENT == 0);
+static_assert(sizeof(FProjectileRecordedProjectile) % PROJECTILE_RECORDING_ALIGNMENT == 0);
+
+/** appends Count uninitialized items and returns the byte offset to the first one */
+template<typename T>
+static int32 AppendItems(TArray<uint8>& Buffer, uint32 Count)
+{
+	return Buffer.AddUninitialized(sizeof(T) * Count);
+}
+
+static void AlignBuffer(TArray<uint8>& Buffer)
+{
+	int32 Padding = Align(Buffer.Num(), PROJECTILE_RECORDING_ALIGNMENT) - Buffer.Num();
+	Buffer.AddZeroed(Padding);
+}
+
+FProjectileRecorder::FProjectileRecorder()
+	: FillIndex(0)
+	, FrameNumber(0)
+	, File(nullptr)
+	, Thread(nullptr)
+	, WorkEvent(nullptr)
+	, IdleEvent(nullptr)
+	, bStopRequested(false)
+	, PendingIndex(INDEX_NONE)
+{
+}
+
+FProjectileRecorder::~FProjectileRecorder()
+{
+	Stop();
+}
+
+bool FProjectileRecorder::Start(const FString& Filename)
+{
+	check(!File);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	File = PlatformFile.OpenWrite(*Filename);
+	if (!File)
+	{
+		UE_LOG(LogProjectile, Error, TEXT("Failed to open projectile recording '%s'"), *Filename);
+		return false;
+	}
+
+	FProjectileRecordingFileHeader Header = {};
+	Header.Magic = PROJECTILE_RECORDING_MAGIC;
+	Header.Version = PROJECTILE_RECORDING_VERSION;
+	File->Write((const uint8*)&Header, sizeof(Header));
+
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	IdleEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	bStopRequested = false;
+	PendingIndex = INDEX_NONE;
+
+	Thread = FRunnableThread::Create(this, TEXT("ProjectileRecorder"), 0, TPri_BelowNormal);
+	return true;
+}
+
+void FProjectileRecorder::Stop()
+{
+	if (!File)
+	{
+		return;
+	}
+
+	WaitForWriter();
+
+	bStopRequested = true;
+	WorkEvent->Trigger();
+	Thread->WaitForCompletion();
+
+	delete Thread;
+	Thread = nullptr;
+
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	FPlatformProcess::ReturnSynchEventToPool(IdleEvent);
+	WorkEvent = nullptr;
+	IdleEvent = nullptr;
+
+	delete File;
+	File = nullptr;
+}
+
+uint16 FProjectileRecorder::GetConfigId(UProjectileConfig* Config)
+{
+	if (uint16* Id = ConfigIds.Find(Config))
+	{
+		return *Id;
+	}
+
+	uint16 Id = (uint16)ConfigIds.Num();
+	ConfigIds.Add(Config, Id);
+	NewConfigs.Add(Config);
+	return Id;
+}
+
+void FProjectileRecorder::RecordSpawn(UProjectileConfig* Config, const FVector& Location, const FRotator& Rotation)
+{
+	FProjectileRecordedSpawn& Spawn = FrameSpawns.AddZeroed_GetRef();
+	Spawn.Location = Location;
+	Spawn.Rotation = FRotator3f(Rotation);
+	Spawn.ConfigId = GetConfigId(Config);
+}
+
+void FProjectileRecorder::CaptureFrame(const UProjectileSubsystem& Subsystem, float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileRecorder::CaptureFrame);
+
+	check(File);
+
+	// make sure every chunk config has an id before we write the config table
+	uint32 ProjectileCount = 0;
+	for (const FProjectileChunk& Chunk : Subsystem.Simulation.Chunks)
+	{
+		GetConfigId(Subsystem.GetChunkConfig(Chunk));
+		ProjectileCount += Chunk.Count;
+	}
+
+	// the buffer keeps its allocation from two frames ago, so this doesn't allocate in steady state
+	TArray<uint8>& Buffer = Buffers[FillIndex];
+	Buffer.Reset();
+
+	int32 HeaderOffset = AppendItems<FProjectileRecordingFrameHeader>(Buffer, 1);
+
+	for (UProjectileConfig* Config : NewConfigs)
+	{
+		FTCHARToUTF8 Path(*FSoftObjectPath(Config).ToString());
+
+		int32 Offset = AppendItems<FProjectileRecordedConfig>(Buffer, 1);
+		FProjectileRecordedConfig* Entry = (FProjectileRecordedConfig*)(Buffer.GetData() + Offset);
+		*Entry = {};
+		Entry->ConfigId = ConfigIds[Config];
+		Entry->PathLength = (uint16)Path.Length();
+
+		Buffer.Append((const uint8*)Path.Get(), Path.Length());
+		AlignBuffer(Buffer);
+	}
+
+	if (FrameSpawns.Num() > 0)
+	{
+		int32 Offset = AppendItems<FProjectileRecordedSpawn>(Buffer, FrameSpawns.Num());
+		FMemory::Memcpy(Buffer.GetData() + Offset, FrameSpawns.GetData(), sizeof(FProjectileRecordedSpawn) * FrameSpawns.Num());
+	}
+
+	{
+		int32 Offset = AppendItems<FProjectileRecordedProjectile>(Buffer, ProjectileCount);
+		FProjectileRecordedProjectile* Out = (FProjectileRecordedProjectile*)(Buffer.GetData() + Offset);
+
+		for (const FProjectileChunk& Chunk : Subsystem.Simulation.Chunks)
+		{
+			uint16 ConfigId = ConfigIds[Subsystem.GetChunkConfig(Chunk)];
+
+			for (uint32 I = 0; I < Chunk.Count; ++I)
+			{
+				const FProjectileState* State = Chunk.States + I;
+
+				Out->Position = FVector3f(State->Position);
+				Out->Velocity = State->Velocity;
+				Out->Handle = Chunk.Handles[I];
+				Out->ConfigId = ConfigId;
+				Out->Pad = 0;
+				++Out;
+			}
+		}
+	}
+
+	// the buffer might have reallocated, so fill in the header last
+	FProjectileRecordingFrameHeader* Header = (FProjectileRecordingFrameHeader*)(Buffer.GetData() + HeaderOffset);
+	*Header = {};
+	Header->Magic = PROJECTILE_RECORDING_FRAME_MAGIC;
+	Header->Size = (uint32)Buffer.Num();
+	Header->FrameNumber = FrameNumber++;
+	Header->DeltaTime = DeltaTime;
+	Header->NewConfigCount = (uint32)NewConfigs.Num();
+	Header->SpawnCount = (uint32)FrameSpawns.Num();
+	Header->ProjectileCount = ProjectileCount;
+
+	NewConfigs.Reset();
+	FrameSpawns.Reset();
+
+	// hand the buffer to the writer thread. we only block if the disk can't keep up
+	WaitForWriter();
+	PendingIndex = (int32)FillIndex;
+	WorkEvent->Trigger();
+
+	FillIndex ^= 1;
+}
+
+void FProjectileRecorder::WaitForWriter()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileRecorder::WaitForWriter);
+
+	while (PendingIndex != INDEX_NONE)
+	{
+		IdleEvent->Wait();
+	}
+}
+
+uint32 FProjectileRecorder::Run()
+{
+	for (;;)
+	{
+		WorkEvent->Wait();
+
+		int32 Index = PendingIndex;
+		if (Index != INDEX_NONE)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileRecorder::WriteFrame);
+
+			const TArray<uint8>& Buffer = Buffers[Index];
+			File->Write(Buffer.GetData(), Buffer.Num());
+
+			PendingIndex = INDEX_NONE;
+			IdleEvent->Trigger();
+		}
+
+		if (bStopRequested)
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+void FProjectileRecorder::Exit()
+{
+	File->Flush();
+}
+
+// ------------------------------------------------------
+
+FProjectileRecordingReader::FProjectileRecordingReader()
+	: Data(nullptr)
+	, Size(0)
+{
+}
+
+FProjectileRecordingReader::~FProjectileRecordingReader()
+{
+	Close();
+}
+
+bool FProjectileRecordingReader::Open(const FString& Filename)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileRecordingReader::Open);
+
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (!MappedFile)
+	{
+		UE_LOG(LogProjectile, Error, TEXT("Failed to map projectile recording '%s'"), *Filename);
+		return false;
+	}
+
+	Size = MappedFile->GetFileSize();
+	if (Size < (int64)sizeof(FProjectileRecordingFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	MappedRegion.Reset(MappedFile->MapRegion(0, Size));
+	Data = MappedRegion->GetMappedPtr();
+
+	const FProjectileRecordingFileHeader* FileHeader = (const FProjectileRecordingFileHeader*)Data;
+	if (FileHeader->Magic != PROJECTILE_RECORDING_MAGIC || FileHeader->Version != PROJECTILE_RECORDING_VERSION)
+	{
+		UE_LOG(LogProjectile, Error, TEXT("'%s' is not a projectile recording"), *Filename);
+		Close();
+		return false;
+	}
+
+	// walk the frames once to build the index. a recording that was cut short
+	// (crash, full disk) simply ends at the last complete frame
+	int64 Offset = sizeof(FProjectileRecordingFileHeader);
+	while (Offset + (int64)sizeof(FProjectileRecordingFrameHeader) <= Size)
+	{
+		// a frame smaller than its header would never advance the walk, and every count
+		// has to fit inside the frame before GetFrame builds views over it
+		const FProjectileRecordingFrameHeader* Header = (const FProjectileRecordingFrameHeader*)(Data + Offset);
+		if (Header->Magic != PROJECTILE_RECORDING_FRAME_MAGIC || Header->Size < sizeof(FProjectileRecordingFrameHeader) || Offset + Header->Size > Size)
+		{
+			break;
+		}
+
+		const uint8* FrameEnd = Data + Offset + Header->Size;
+		const uint8* ConfigPtr = (const uint8*)(Header + 1);
+		bool bValidFrame = true;
+		for (uint32 I = 0; I < Header->NewConfigCount; ++I)
+		{
+			if (FrameEnd - ConfigPtr < (int64)sizeof(FProjectileRecordedConfig))
+			{
+				bValidFrame = false;
+				break;
+			}
+
+			const FProjectileRecordedConfig* Entry = (const FProjectileRecordedConfig*)ConfigPtr;
+			const UTF8CHAR* Path = (const UTF8CHAR*)(Entry + 1);
+
+			int64 EntrySize = Align(sizeof(FProjectileRecordedConfig) + Entry->PathLength, PROJECTILE_RECORDING_ALIGNMENT);
+			if (FrameEnd - ConfigPtr < EntrySize)
+			{
+				bValidFrame = false;
+				break;
+			}
+
+			if (ConfigPaths.Num() <= Entry->ConfigId)
+			{
+				ConfigPaths.SetNum(Entry->ConfigId + 1);
+			}
+			ConfigPaths[Entry->ConfigId] = FString(FUTF8ToTCHAR((const ANSICHAR*)Path, Entry->PathLength));
+
+			ConfigPtr += EntrySize;
+		}
+
+		uint64 PayloadSize = (uint64)Header->SpawnCount * sizeof(FProjectileRecordedSpawn)
+			+ (uint64)Header->ProjectileCount * sizeof(FProjectileRecordedProjectile);
+		if (!bValidFrame || (uint64)(FrameEnd - ConfigPtr) < PayloadSize)
+		{
+			UE_LOG(LogProjectile, Warning, TEXT("Projectile recording '%s' has a corrupt frame at offset %lld, stopping there"), *Filename, Offset);
+			break;
+		}
+
+		FrameOffsets.Add(Offset);
+		Offset += Header->Size;
+	}
+
+	Configs.SetNum(ConfigPaths.Num());
+	return true;
+}
+
+void FProjectileRecordingReader::Close()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	Data = nullptr;
+	Size = 0;
+	FrameOffsets.Reset();
+	ConfigPaths.Reset();
+	Configs.Reset();
+}
+
+FProjectileRecordingFrame FProjectileRecordingReader::GetFrame(int32 FrameIndex) const
+{
+	const FProjectileRecordingFrameHeader* Header = (const FProjectileRecordingFrameHeader*)(Data + FrameOffsets[FrameIndex]);
+
+	// skip over the config table, it was already consumed when indexing
+	const uint8* Ptr = (const uint8*)(Header + 1);
+	for (uint32 I = 0; I < Header->NewConfigCount; ++I)
+	{
+		const FProjectileRecordedConfig* Entry = (const FProjectileRecordedConfig*)Ptr;
+		Ptr += Align(sizeof(FProjectileRecordedConfig) + Entry->PathLength, PROJECTILE_RECORDING_ALIGNMENT);
+	}
+
+	const FProjectileRecordedSpawn* Spawns = (const FProjectileRecordedSpawn*)Ptr;
+	const FProjectileRecordedProjectile* Projectiles = (const FProjectileRecordedProjectile*)(Spawns + Header->SpawnCount);
+
+	FProjectileRecordingFrame Frame;
+	Frame.Header = Header;
+	Frame.Spawns = MakeArrayView(Spawns, Header->SpawnCount);
+	Frame.Projectiles = MakeArrayView(Projectiles, Header->ProjectileCount);
+	return Frame;
+}
+
+UProjectileConfig* FProjectileRecordingReader::GetConfig(uint16 ConfigId) const
+{
+	if (!Configs.IsValidIndex(ConfigId))
+	{
+		return nullptr;
+	}
+
+	UProjectileConfig* Config = Configs[ConfigId].Get();
+	if (!Config)
+	{
+		Config = Cast<UProjectileConfig>(FSoftObjectPath(ConfigPaths[ConfigId]).TryLoad());
+		Configs[ConfigId] = Config;
+	}
+
+	return Config;
+}
+
+const FString& FProjectileRecordingReader::GetConfigPath(uint16 ConfigId) const
+{
+	return ConfigPaths[ConfigId];
+}
+
+// ------------------------------------------------------
+
+static void StartProjectileRecording(const TArray<FString>& Args, UWorld* World)
+{
+	FString Filename = Args.Num() > 0
+		? Args[0]
+		: FPaths::ProjectSavedDir() / TEXT("Projectiles") / FString::Printf(TEXT("%s.prjrec"), *FDateTime::Now().ToString());
+
+	if (UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(World))
+	{
+		Subsystem->StartRecording(Filename);
+	}
+}
+
+static void StopProjectileRecording(const TArray<FString>& Args, UWorld* World)
+{
+	if (UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(World))
+	{
+		Subsystem->StopRecording();
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GStartProjectileRecordingCmd(
+	TEXT("Projectile.Record.Start"),
+	TEXT("Start recording the projectile subsystem to a file. Optional argument: filename"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartProjectileRecording));
+
+static FAutoConsoleCommandWithWorldAndArgs GStopProjectileRecordingCmd(
+	TEXT("Projectile.Record.Stop"),
+	TEXT("Stop recording the projectile subsystem"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StopProjectileRecording));
@@ -0,0 +1,161 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+#include "ProjectileHandle.h"
+
+class UProjectileConfig;
+class UProjectileSubsystem;
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// File layout:
+//
+// |FileHeader|Frame|Frame|Frame|...
+//
+// every frame is self contained and 8-byte aligned so the reader can hand out views
+// straight into the mapped memory without copying anything
+//
+// |FrameHeader|NewConfigs|Spawns|Projectiles|
+//
+// configs are written once, the first frame they show up in, and referenced by id after that
+
+/** Start of a recording file */
+struct FProjectileRecordingFileHeader
+{
+	uint32				Magic;			// PROJECTILE_RECORDING_MAGIC
+	uint32				Version;		// PROJECTILE_RECORDING_VERSION
+};
+
+/** Start of every frame in a recording file */
+struct FProjectileRecordingFrameHeader
+{
+	uint32				Magic;				// PROJECTILE_RECORDING_FRAME_MAGIC
+	uint32				Size;				// total size of the frame including this header
+	uint32				FrameNumber;		// index of this frame in the recording
+	float				DeltaTime;			// frame delta the subsystem ticked with
+	uint32				NewConfigCount;		// number of FProjectileRecordedConfig following this header
+	uint32				SpawnCount;			// number of FProjectileRecordedSpawn following the configs
+	uint32				ProjectileCount;	// number of FProjectileRecordedProjectile following the spawns
+	uint32				Pad;
+};
+
+/** Config referenced for the first time in a frame. The path is stored as UTF-8 right after */
+struct FProjectileRecordedConfig
+{
+	uint16				ConfigId;		// id the spawns and projectiles refer to
+	uint16				PathLength;		// number of UTF-8 bytes following (not null terminated)
+	uint32				Pad;
+};
+
+/** A CreateProjectile call that happened during the frame */
+struct FProjectileRecordedSpawn
+{
+	FVector				Location;
+	FRotator3f			Rotation;
+	uint16				ConfigId;
+	uint16				Pad;
+};
+
+/** Compact copy of a live projectile at the end of the frame */
+struct FProjectileRecordedProjectile
+{
+	FVector3f			Position;		// float32 is enough for inspecting a frame
+	FVector3f			Velocity;
+	FProjectileHandle	Handle;
+	uint16				ConfigId;
+	uint16				Pad;
+};
+
+/**
+ * Streams per-frame snapshots of the projectile subsystem to disk.
+ * The game thread only serializes into one of two buffers, a background thread writes the other one
+ */
+class PROJECTILEPERF_API FProjectileRecorder : public FRunnable
+{
+public:
+
+	FProjectileRecorder();
+	virtual ~FProjectileRecorder() override;
+
+	/** open the file and start the writer thread */
+	bool Start(const FString& Filename);
+	/** flush the last frame, stop the writer thread and close the file */
+	void Stop();
+
+	/** remember a spawn so it can be played back later. game thread only */
+	void RecordSpawn(UProjectileConfig* Config, const FVector& Location, const FRotator& Rotation);
+	/** serialize the current state of the subsystem and hand it to the writer thread. game thread only */
+	void CaptureFrame(const UProjectileSubsystem& Subsystem, float DeltaTime);
+
+	// ~ begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Exit() override;
+	// ~ end FRunnable interface
+
+private:
+
+	uint16 GetConfigId(UProjectileConfig* Config);
+	/** blocks until the writer thread is done with the previous buffer */
+	void WaitForWriter();
+
+	TArray<uint8>						Buffers[2];			// double buffer, one is filled while the other is written
+	uint32								FillIndex;			// buffer the game thread is serializing into
+	TArray<FProjectileRecordedSpawn>	FrameSpawns;		// spawns since the last captured frame
+	TArray<UProjectileConfig*>			NewConfigs;			// configs seen for the first time since the last captured frame
+	TMap<UProjectileConfig*, uint16>	ConfigIds;
+	uint32								FrameNumber;
+
+	IFileHandle*						File;
+	FRunnableThread*					Thread;
+	FEvent*								WorkEvent;			// signaled by the game thread when a buffer is ready
+	FEvent*								IdleEvent;			// signaled by the writer thread when it's done
+	std::atomic<bool>					bStopRequested;
+	std::atomic<int32>					PendingIndex;		// buffer waiting to be written, INDEX_NONE if none
+};
+
+/** View of a single frame inside a mapped recording. Only valid while the reader is alive */
+struct FProjectileRecordingFrame
+{
+	const FProjectileRecordingFrameHeader*			Header;
+	TArrayView<const FProjectileRecordedSpawn>		Spawns;
+	TArrayView<const FProjectileRecordedProjectile>	Projectiles;
+};
+
+/**
+ * Memory maps a recording and gives random access to its frames for playback and scrubbing.
+ * Nothing is copied, frames are views into the mapped file
+ */
+class PROJECTILEPERF_API FProjectileRecordingReader
+{
+public:
+
+	FProjectileRecordingReader();
+	~FProjectileRecordingReader();
+
+	/** map the file and index the frames. returns false if the file is missing or not a recording */
+	bool Open(const FString& Filename);
+	void Close();
+
+	int32 GetFrameCount() const { return FrameOffsets.Num(); }
+	FProjectileRecordingFrame GetFrame(int32 FrameIndex) const;
+
+	/** resolves a config id to the config asset it was recorded with. can be null if the asset is gone */
+	UProjectileConfig* GetConfig(uint16 ConfigId) const;
+	/** asset path of the config as it was recorded */
+	const FString& GetConfigPath(uint16 ConfigId) const;
+
+private:
+
+	TUniquePtr<IMappedFileHandle>		MappedFile;
+	TUniquePtr<IMappedFileRegion>		MappedRegion;
+	const uint8*						Data;
+	int64								Size;
+	TArray<int64>						FrameOffsets;	// byte offset of each frame header
+	TArray<FString>						ConfigPaths;	// indexed by config id
+	mutable TArray<TWeakObjectPtr<UProjectileConfig>> Configs;	// lazily loaded, indexed by config id
+};
@@ -4,6 +4,8 @@
 #include "ProjectileConfig.h"
 #include "ActorProjectile.h"
 #include "ProjectileSubsystem.h"
+#include "ActorProjectilePool.h"
+#include "MassProjectileSubsystem.h"
 
 // Engine
 #include "Components/BoxComponent.h"
@@ -36,6 +38,22 @@ void AProjectileSpawner::PostEditChangeProperty(struct FPropertyChangedEvent& Pr
 }
 #endif // WITH_EDITOR
 
+static FTransform GetProjectileSpawnTM(FRandomStream& Stream, const FVector& SpawnBounds)
+{
+	FVector Location = {};
+	Location.X = Stream.FRandRange(-FMath::Abs(SpawnBounds.X), FMath::Abs(SpawnBounds.X));
+	Location.Y = Stream.FRandRange(-FMath::Abs(SpawnBounds.Y), FMath::Abs(SpawnBounds.Y));
+	Location.Z = Stream.FRandRange(-FMath::Abs(SpawnBounds.Z), FMath::Abs(SpawnBounds.Z));
+
+	FRotator Rotation = {};
+	Rotation.Pitch = Stream.FRandRange(-180.f, 180.f);
+	Rotation.Yaw = Stream.FRandRange(-180.f, 180.f);
+	Rotation.Roll = Stream.FRandRange(-180.f, 180.f);
+
+	FTransform SpawnTM(Rotation.Quaternion(), Location);
+	return SpawnTM;
+}
+
 void AProjectileSpawner::BeginPlay()
 {
 	Super::BeginPlay();
@@ -43,22 +61,75 @@ void AProjectileSpawner::BeginPlay()
 	// preallocate the projectiles array that we maintain
 	ActorProjectiles.Reserve(SpawnCount);
 	ActorlessProjectiles.Reserve(SpawnCount);
+	MassProjectiles.Reserve(SpawnCount);
+
+	if (RandomSeed != 0)
+	{
+		RandomStream.Initialize(RandomSeed);
+	}
+	else
+	{
+		RandomStream.GenerateNewSeed();
+	}
+
+	ActorRandomStream.Initialize(RandomStream.GetCurrentSeed() ^ 0x5bd1e995);
+	MassRandomStream.Initialize(RandomStream.GetCurrentSeed() ^ 0x1b873593);
+
+	UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld());
+	check(Subsystem);
+	ProjectileOwnerId = Subsystem->RegisterOwner(this);
+
+	if (bSpawnActorProjectiles && bPoolActorProjectiles)
+	{
+		UActorProjectilePool* Pool = UActorProjectilePool::Get(GetWorld());
+		check(Pool);
+		Pool->Prewarm(AActorProjectile::StaticClass(), PoolPrewarmCount > 0 ? PoolPrewarmCount : SpawnCount);
+	}
+
+	if (!PlaybackRecording.IsEmpty())
+	{
+		PlaybackReader = MakeUnique<FProjectileRecordingReader>();
+		PlaybackFrame = 0;
+
+		if (!PlaybackReader->Open(FPaths::Combine(FPaths::ProjectDir(), PlaybackRecording))
+			|| PlaybackReader->GetFrameCount() == 0)
+		{
+			PlaybackReader.Reset();
+		}
+	}
+
+	for (FProjectileFirePattern& Pattern : FirePatterns)
+	{
+		Pattern.TimeToFire = 0.0f;
+		Pattern.NextEmitter = 0;
+		Pattern.Emitters.Reset(Pattern.EmitterCount);
+
+		if (Pattern.Shape == EProjectileFireShape::Cone)
+		{
+			for (int32 I = 0; I < Pattern.EmitterCount; ++I)
+			{
+				Pattern.Emitters.Add(GetProjectileSpawnTM(RandomStream, SpawnBounds));
+			}
+		}
+	}
 }
 
-static FTransform GetProjectileSpawnTM(const FVector& SpawnBounds)
+void AProjectileSpawner::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	FVector Location = {};
-	Location.X = FMath::FRandRange(-FMath::Abs(SpawnBounds.X), FMath::Abs(SpawnBounds.X));
-	Location.Y = FMath::FRandRange(-FMath::Abs(SpawnBounds.Y), FMath::Abs(SpawnBounds.Y));
-	Location.Z = FMath::FRandRange(-FMath::Abs(SpawnBounds.Z), FMath::Abs(SpawnBounds.Z));
+	if (UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld()))
+	{
+		Subsystem->UnregisterOwner(ProjectileOwnerId);
+	}
 
-	FRotator Rotation = {};
-	Rotation.Pitch = FMath::FRandRange(-180.f, 180.f);
-	Rotation.Yaw = FMath::FRandRange(-180.f, 180.f);
-	Rotation.Roll = FMath::FRandRange(-180.f, 180.f);
+	Super::EndPlay(EndPlayReason);
+}
 
-	FTransform SpawnTM(Rotation.Quaternion(), Location);
-	return SpawnTM;
+void AProjectileSpawner::OnProjectilesDestroyed(TArrayView<const FProjectileDestroyEvent> Events)
+{
+	for (const FProjectileDestroyEvent& Event : Events)
+	{
+		ActorlessProjectiles.Remove(Event.Handle);
+	}
 }
 
 void AProjectileSpawner::Tick(float DeltaTime)
@@ -67,14 +138,21 @@ void AProjectileSpawner::Tick(float DeltaTime)
 	
 	Super::Tick(DeltaTime);
 
+	if (FirePatterns.Num() > 0)
+	{
+		TickFirePatterns(DeltaTime);
+		return;
+	}
+
 	{
 		// count number of destroyed projectiles that we need to respawn
 		uint32 ProjCount = (uint32)ActorProjectiles.Num();
 		uint32 InvalidProjCount = (uint32)SpawnCount - ProjCount;
 		for (uint32 I = ProjCount; I-- > 0;)
 		{
+			// pooled projectiles are never destroyed, they are parked or reused by someone else
 			AActorProjectile* Proj = ActorProjectiles[I];
-			if (!IsValid(Proj))
+			if (!IsValid(Proj) || Proj->bParked || Proj->GetOwner() != this)
 			{
 				++InvalidProjCount;
 				ActorProjectiles.RemoveAtSwap(I, 1, false);
@@ -85,40 +163,184 @@ void AProjectileSpawner::Tick(float DeltaTime)
 		{
 			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnActorProjectile);
 
-			FTransform SpawnTM = GetProjectileSpawnTM(SpawnBounds);
-
-			AActorProjectile* Actor = GetWorld()->SpawnActorDeferred<AActorProjectile>(AActorProjectile::StaticClass(),
-				SpawnTM, this, NULL, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
-			ActorProjectiles.Add(Actor);
-			Actor->InitFromConfig(Config);
-			Actor->FinishSpawning(SpawnTM);
+			FTransform SpawnTM = GetProjectileSpawnTM(ActorRandomStream, SpawnBounds);
+			ActorProjectiles.Add(SpawnActorProjectile(Config, SpawnTM));
 		}
 	}
 
+	if (bSpawnMassProjectiles)
 	{
-		UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld());
-		check(Subsystem);
+		UMassProjectileSubsystem* MassSubsystem = UMassProjectileSubsystem::Get(GetWorld());
+		check(MassSubsystem);
 
 		// count number of destroyed projectiles that we need to respawn
-		uint32 ProjCount = (uint32)ActorlessProjectiles.Num();
-		uint32 InvalidProjCount = (uint32)SpawnCount - ProjCount;
+		uint32 ProjCount = (uint32)MassProjectiles.Num();
+		uint32 InvalidProjCount = (uint32)FMath::Max(SpawnCount - (int32)ProjCount, 0);
 		for (uint32 I = ProjCount; I-- > 0;)
 		{
-			FProjectileHandle Proj = ActorlessProjectiles[I];
-			if (!Subsystem->IsProjectileValid(Proj))
+			if (!MassSubsystem->IsProjectileValid(MassProjectiles[I]))
 			{
 				++InvalidProjCount;
-				ActorlessProjectiles.RemoveAtSwap(I, 1, false);
+				MassProjectiles.RemoveAtSwap(I, 1, false);
 			}
 		}
 
+		for (uint32 I = 0; I < InvalidProjCount; ++I)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnMassProjectile);
+
+			FTransform SpawnTM = GetProjectileSpawnTM(MassRandomStream, SpawnBounds);
+			MassProjectiles.Add(MassSubsystem->CreateProjectile(Config, SpawnTM.GetLocation(), SpawnTM.GetRotation().Rotator()));
+		}
+	}
+
+	if (PlaybackReader)
+	{
+		UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld());
+		check(Subsystem);
+
+		// replay what the recorded frame spawned. the spawns are already in world space
+		FProjectileRecordingFrame Frame = PlaybackReader->GetFrame(PlaybackFrame);
+		PlaybackFrame = (PlaybackFrame + 1) % PlaybackReader->GetFrameCount();
+
+		for (const FProjectileRecordedSpawn& Spawn : Frame.Spawns)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnActorlessProjectile);
+
+			UProjectileConfig* SpawnConfig = PlaybackReader->GetConfig(Spawn.ConfigId);
+			Subsystem->CreateProjectile(SpawnConfig ? SpawnConfig : Config, Spawn.Location, FRotator(Spawn.Rotation));
+		}
+	}
+	else
+	{
+		UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld());
+		check(Subsystem);
+
+		// destroyed projectiles were already removed by OnProjectilesDestroyed,
+		// so whatever is missing from SpawnCount needs to be respawned
+		uint32 ProjCount = (uint32)ActorlessProjectiles.Num();
+		uint32 InvalidProjCount = (uint32)FMath::Max(SpawnCount - (int32)ProjCount, 0);
+
 		for (uint32 I = 0; I < InvalidProjCount; ++I)
 		{
 			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnActorlessProjectile);
 
-			FTransform SpawnTM = GetProjectileSpawnTM(SpawnBounds);
-			FProjectileHandle Handle = Subsystem->CreateProjectile(Config, SpawnTM.GetLocation(), SpawnTM.GetRotation().Rotator());
-			ActorlessProjectiles.Add(Handle);
+			FTransform SpawnTM = GetProjectileSpawnTM(RandomStream, SpawnBounds);
+			FProjectileHandle Handle = Subsystem->CreateProjectile(Config, SpawnTM.GetLocation(),
+				SpawnTM.GetRotation().Rotator(), ProjectileOwnerId);
+
+			// rejected spawns are tried again next frame
+			if (Subsystem->IsProjectileValid(Handle))
+			{
+				ActorlessProjectiles.Add(Handle);
+			}
+		}
+	}
+}
+
+void AProjectileSpawner::TickFirePatterns(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AProjectileSpawner::TickFirePatterns);
+
+	for (FProjectileFirePattern& Pattern : FirePatterns)
+	{
+		Pattern.TimeToFire -= DeltaTime;
+
+		switch (Pattern.Mode)
+		{
+		case EProjectileFireMode::Burst:
+		{
+			// one volley per elapsed interval, a hitch fires the missed volleys all at once like a real game would.
+			// no interval means one volley every frame
+			float Interval = Pattern.BurstInterval > 0.0f ? Pattern.BurstInterval : FMath::Max(DeltaTime, UE_SMALL_NUMBER);
+			while (Pattern.TimeToFire <= 0.0f)
+			{
+				FireProjectiles(Pattern, Pattern.BurstCount);
+				Pattern.TimeToFire += Interval;
+			}
+			break;
+		}
+		case EProjectileFireMode::Continuous:
+		{
+			if (Pattern.FireRate > 0.0f)
+			{
+				// carry the fractional shot over so the rate is exact regardless of frame rate
+				float ShotInterval = 1.0f / Pattern.FireRate;
+				int32 ShotCount = FMath::CeilToInt(-Pattern.TimeToFire / ShotInterval);
+				if (ShotCount > 0)
+				{
+					FireProjectiles(Pattern, ShotCount);
+					Pattern.TimeToFire += ShotInterval * (float)ShotCount;
+				}
+			}
+			break;
+		}
 		}
 	}
 }
+
+void AProjectileSpawner::FireProjectiles(FProjectileFirePattern& Pattern, int32 Count)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AProjectileSpawner::FireProjectiles);
+
+	UProjectileConfig* FireConfig = Pattern.Config ? Pattern.Config : Config;
+	if (!FireConfig)
+	{
+		return;
+	}
+
+	UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld());
+	check(Subsystem);
+
+	for (int32 I = 0; I < Count; ++I)
+	{
+		FTransform SpawnTM;
+
+		if (Pattern.Shape == EProjectileFireShape::Cone && Pattern.Emitters.Num() > 0)
+		{
+			const FTransform& Emitter = Pattern.Emitters[Pattern.NextEmitter];
+			Pattern.NextEmitter = (Pattern.NextEmitter + 1) % Pattern.Emitters.Num();
+
+			FVector Direction = RandomStream.VRandCone(Emitter.GetUnitAxis(EAxis::X), FMath::DegreesToRadians(Pattern.ConeHalfAngle));
+			SpawnTM = FTransform(Direction.Rotation(), Emitter.GetLocation());
+		}
+		else
+		{
+			SpawnTM = GetProjectileSpawnTM(RandomStream, SpawnBounds);
+		}
+
+		if (bSpawnActorlessProjectiles)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnActorlessProjectile);
+			Subsystem->CreateProjectile(FireConfig, SpawnTM.GetLocation(), SpawnTM.GetRotation().Rotator());
+		}
+
+		if (bSpawnActorProjectiles)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnActorProjectile);
+			SpawnActorProjectile(FireConfig, SpawnTM);
+		}
+
+		if (bSpawnMassProjectiles)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(SpawnMassProjectile);
+			UMassProjectileSubsystem::Get(GetWorld())->CreateProjectile(FireConfig, SpawnTM.GetLocation(), SpawnTM.GetRotation().Rotator());
+		}
+	}
+}
+
+AActorProjectile* AProjectileSpawner::SpawnActorProjectile(UProjectileConfig* SpawnConfig, const FTransform& SpawnTM)
+{
+	if (bPoolActorProjectiles)
+	{
+		UActorProjectilePool* Pool = UActorProjectilePool::Get(GetWorld());
+		check(Pool);
+		return Pool->Acquire(AActorProjectile::StaticClass(), SpawnConfig, SpawnTM, this);
+	}
+
+	AActorProjectile* Actor = GetWorld()->SpawnActorDeferred<AActorProjectile>(AActorProjectile::StaticClass(),
+		SpawnTM, this, NULL, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	Actor->InitFromConfig(SpawnConfig);
+	Actor->FinishSpawning(SpawnTM);
+	return Actor;
+}
@@ -5,18 +5,80 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "ProjectileHandle.h"
+#include "ProjectileRecorder.h"
+#include "ProjectileSubsystem.h"
+#include "MassEntityTypes.h"
 #include "ProjectileSpawner.generated.h"
 
 class UProjectileConfig;
 class AActorProjectile;
 class UBoxComponent;
 
+UENUM()
+enum class EProjectileFireMode : uint8
+{
+	/** Fire BurstCount projectiles at once every BurstInterval (synchronized volleys) */
+	Burst,
+	/** Fire FireRate projectiles per second (sustained fire, miniguns) */
+	Continuous,
+};
+
+UENUM()
+enum class EProjectileFireShape : uint8
+{
+	/** Random location inside SpawnBounds, random direction */
+	RandomInBounds,
+	/** From one of EmitterCount emitters placed inside SpawnBounds, inside a cone around the emitter direction */
+	Cone,
+};
+
+/** One weapon-like source of projectiles. Spawners can mix several of these */
+USTRUCT()
+struct FProjectileFirePattern
+{
+	GENERATED_BODY()
+
+	/** What kind of projectiles to fire. Uses the spawner Config if not set */
+	UPROPERTY(EditAnywhere)
+	UProjectileConfig* Config = nullptr;
+
+	UPROPERTY(EditAnywhere)
+	EProjectileFireMode Mode = EProjectileFireMode::Burst;
+
+	UPROPERTY(EditAnywhere)
+	EProjectileFireShape Shape = EProjectileFireShape::RandomInBounds;
+
+	/** Projectiles per volley */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="Mode==EProjectileFireMode::Burst", UIMin="1", ClampMin="1"))
+	int32 BurstCount = 32;
+
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="Mode==EProjectileFireMode::Burst", UIMin="0.0", ClampMin="0.0", ForceUnits="s"))
+	float BurstInterval = 1.0f;
+
+	/** Projectiles per second */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="Mode==EProjectileFireMode::Continuous", UIMin="0.0", ClampMin="0.0"))
+	float FireRate = 100.0f;
+
+	/** Number of emitters the cone pattern rotates through, clustered fights use few emitters in small bounds */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="Shape==EProjectileFireShape::Cone", UIMin="1", ClampMin="1"))
+	int32 EmitterCount = 4;
+
+	/** Spread of the cone, shotguns use wide cones */
+	UPROPERTY(EditAnywhere, Meta=(EditCondition="Shape==EProjectileFireShape::Cone", UIMin="0.0", ClampMin="0.0", UIMax="180.0", ClampMax="180.0", ForceUnits="deg"))
+	float ConeHalfAngle = 5.0f;
+
+	TArray<FTransform>	Emitters;		// seeded at BeginPlay
+	float				TimeToFire;		// time left until the next volley or shot
+	int32				NextEmitter;	// emitters are used round robin
+};
+
 /**
  * Actor that spawns projectiles for performance testing
- * It will keep spawning projectiles when they are destroyed to maintain a consistent count
+ * It will keep spawning projectiles when they are destroyed to maintain a consistent count,
+ * or fire them with FirePatterns to mimic real combat load
  */
 UCLASS()
-class PROJECTILEPERF_API AProjectileSpawner : public AActor
+class PROJECTILEPERF_API AProjectileSpawner : public AActor, public IProjectileOwner
 {
 	GENERATED_BODY()
 	
@@ -47,10 +109,50 @@ public:
 	UPROPERTY(EditInstanceOnly)
 	uint32 bSpawnActorlessProjectiles:1;
 
+	/** Spawn the projectiles as Mass entities (UMassProjectileSubsystem), to compare Mass against the other two */
+	UPROPERTY(EditInstanceOnly)
+	uint32 bSpawnMassProjectiles:1;
+
+	/** Reuse actor projectiles from UActorProjectilePool instead of spawning and destroying them */
+	UPROPERTY(EditInstanceOnly, Meta=(EditCondition="bSpawnActorProjectiles"))
+	uint32 bPoolActorProjectiles:1;
+
+	/** Actor projectiles parked in the pool at BeginPlay. 0 uses SpawnCount */
+	UPROPERTY(EditInstanceOnly, Meta=(EditCondition="bSpawnActorProjectiles && bPoolActorProjectiles", UIMin="0", ClampMin="0"))
+	int32 PoolPrewarmCount;
+
+	/** Fire projectiles in volleys/streams instead of keeping SpawnCount alive. Projectiles fired by
+		patterns are fire-and-forget, the spawner doesn't track them. All patterns draw from the seeded stream */
+	UPROPERTY(EditInstanceOnly)
+	TArray<FProjectileFirePattern> FirePatterns;
+
+	/** Replay the actorless spawns of a projectile recording instead of random respawns.
+		Loops when the recording ends. Relative to the project directory */
+	UPROPERTY(EditInstanceOnly)
+	FString PlaybackRecording;
+
+	/** Seed for the spawn location/rotation stream. 0 picks a new seed every run */
+	UPROPERTY(EditInstanceOnly)
+	int32 RandomSeed;
+
+	/** Per spawner streams so spawns don't depend on who else consumed random numbers this frame.
+		Actor and Mass projectiles get their own streams since their (non deterministic) deaths drive how much they consume */
+	FRandomStream RandomStream;
+	FRandomStream ActorRandomStream;
+	FRandomStream MassRandomStream;
+
 	UPROPERTY(Transient)
 	TArray<AActorProjectile*> ActorProjectiles;
 
-	TArray<FProjectileHandle> ActorlessProjectiles;
+	/** live Mass projectiles, Mass has no destroy notifications so these are polled */
+	TArray<FMassEntityHandle> MassProjectiles;
+
+	/** live actorless projectiles, kept up to date by OnProjectilesDestroyed */
+	TSet<FProjectileHandle> ActorlessProjectiles;
+	uint16 ProjectileOwnerId;
+
+	TUniquePtr<FProjectileRecordingReader> PlaybackReader;
+	int32 PlaybackFrame;
 
 	AProjectileSpawner(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
@@ -62,6 +164,16 @@ public:
 
 	// ~ begin AActor interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick(float DeltaTime) override;
 	// ~ end AActor interface
+
+	// ~ begin IProjectileOwner interface
+	virtual void OnProjectilesDestroyed(TArrayView<const FProjectileDestroyEvent> Events) override;
+	virtual AActor* GetProjectileDamageCauser() override { return this; }
+	// ~ end IProjectileOwner interface
+
+	void TickFirePatterns(float DeltaTime);
+	void FireProjectiles(FProjectileFirePattern& Pattern, int32 Count);
+	AActorProjectile* SpawnActorProjectile(UProjectileConfig* SpawnConfig, const FTransform& SpawnTM);
 };
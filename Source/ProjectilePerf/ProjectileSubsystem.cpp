@@ -2,260 +2,521 @@
 
 #include "ProjectileSubsystem.h"
 #include "ProjectileConfig.h"
+#include "ProjectilePerf.h"
+#include "ActorProjectile.h"
+#include "ActorProjectilePool.h"
+#include "ProjectileSpawner.h"
+#include "EngineUtils.h"
+#include "WorldPartition/WorldPartitionSubsystem.h"
+#include "WorldPartition/WorldPartitionRuntimeCell.h"
+#include "WorldPartition/WorldPartitionStreamingSource.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "Physics/Experimental/ChaosInterfaceWrapper.h"
+#include "Collision/CollisionQueryFilterCallback.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/PlayerController.h"
+
+// smallest FixedTimestep taken from the config, 0 or less would divide by zero
+static constexpr float MinFixedTimestep = 1.0f / 1000.0f;
+
+TRACE_DECLARE_FLOAT_COUNTER(ProjectileNsPerRay, TEXT("Projectile/NsPerRay"));
+
+void FProjectileSubmitTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType,
+	ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	Subsystem->SubmitTick(DeltaTime);
+}
 
-// max number of projectiles. hard limited by 16-bits
-#define MAX_PROJECTILE_HANDLES (16384)
-// max number of unique chunks. hard limited by 8-bits
-#define MAX_CHUNK_COUNT (256)
-// max number of projectiles that fit inside a single chunk. hard limited by 8-bits
-#define MAX_CHUNK_PROJECTILE_COUNT (256)
-// number of 32-bit values needed to create a bitmap with 1 bit for each MAX_CHUNK_PROJECTILE_COUNT
-#define MAX_CHUNK_PROJECTILE_BITMAP32_COUNT ((MAX_CHUNK_PROJECTILE_COUNT + 31) / 32)
-
-static_assert(MAX_PROJECTILE_HANDLES <= TNumericLimits<uint16>::Max() + 1);
-static_assert(MAX_CHUNK_COUNT <= TNumericLimits<uint8>::Max() + 1);
-static_assert(MAX_CHUNK_PROJECTILE_COUNT <= TNumericLimits<uint8>::Max() + 1);
-
-// maximum frame delta allowed before we need to substep
-#define MAX_PROJECTILE_TIMESTEP (1.0f / 20.0f)
-// maximum number of substep iterations before continuing
-#define MAX_PROJECTILE_SUBSTEP (4)
-
-static_assert(MAX_PROJECTILE_SUBSTEP > 0);
-static_assert(MAX_PROJECTILE_TIMESTEP > 0.0f);
-
-void FProjectileTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType,
+void FProjectileConsumeTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType,
 	ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
 {
-	Subsystem->Tick(DeltaTime);
+	Subsystem->ConsumeTick(DeltaTime);
 }
 
-struct FProjectileHandleLookup
+FProjectileWorldCollision::FProjectileWorldCollision()
+	: World(nullptr)
+	, QueryParams(TEXT("Projectile"), false, NULL)
+	, bDirectSceneQueries(false)
+	, Filters{}
+	, TraceCycles(0)
+	, TraceRays(0)
 {
-	uint8 Chunk; // index of the chunk in the manager
-	uint8 Index; // index inside the chunk
-};
+	QueryParams.bReturnFaceIndex = false;
+	// the surface type picks how deep a projectile can penetrate
+	QueryParams.bReturnPhysicalMaterial = true;
 
-static_assert(sizeof(FProjectileHandleLookup) == sizeof(FHandleLookup));
+	BuildQueryFilters();
+}
 
-FORCEINLINE FProjectileHandleLookup UnpackHandleLookup(FHandleLookup* Lookup)
+void FProjectileWorldCollision::BuildQueryFilters()
 {
-	// FProjectileHandleLookup and FHandleLookup are bitwise the same in this implementation
-	union 
+	// the same filters the UWorld traces build for every single query
+	Filters[(int32)EProjectileTraceType::All] = CreateQueryFilterData(ECC_WorldDynamic, false,
+		FCollisionResponseParams::DefaultResponseParam.CollisionResponse, QueryParams,
+		FCollisionObjectQueryParams::DefaultObjectQueryParam, false);
+	Filters[(int32)EProjectileTraceType::Static] = CreateQueryFilterData(DefaultCollisionChannel, false,
+		FCollisionResponseContainer::GetDefaultResponseContainer(), QueryParams,
+		FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllStaticObjects), false);
+	Filters[(int32)EProjectileTraceType::Dynamic] = CreateQueryFilterData(DefaultCollisionChannel, false,
+		FCollisionResponseContainer::GetDefaultResponseContainer(), QueryParams,
+		FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllDynamicObjects), false);
+}
+
+void FProjectileWorldCollision::TraceSegments(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+	EProjectileTraceType Type)
+{
+	uint64 StartCycles = FPlatformTime::Cycles64();
+
+	if (bDirectSceneQueries && World->GetPhysicsScene())
+	{
+		TraceSegmentsDirect(Starts, Ends, Count, OutHits, Type);
+	}
+	else
 	{
-		FHandleLookup A;
-		FProjectileHandleLookup B;
-	} Cast = { .A = *Lookup };
+		TraceSegmentsWorld(Starts, Ends, Count, OutHits, Type);
+	}
 
-	return Cast.B;
+	TraceCycles += FPlatformTime::Cycles64() - StartCycles;
+	TraceRays += Count;
 }
 
-FORCEINLINE FHandleLookup PackHandleLookup(FProjectileHandleLookup* Lookup)
+void FProjectileWorldCollision::TraceSegmentsDirect(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+	EProjectileTraceType Type)
 {
-	// FProjectileHandleLookup and FHandleLookup are bitwise the same in this implementation
-	union 
+	TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileWorldCollision::TraceSegmentsDirect);
+
+	FPhysScene& Scene = *World->GetPhysicsScene();
+	const FCollisionFilterData& Filter = Filters[(int32)Type];
+
+	// static/dynamic traces skip the other half of the acceleration structure entirely
+	EQueryFlags QueryFlags = EQueryFlags::PreFilter;
+	QueryFlags |= Type != EProjectileTraceType::Dynamic ? EQueryFlags::StaticQuery : EQueryFlags::None;
+	QueryFlags |= Type != EProjectileTraceType::Static ? EQueryFlags::DynamicQuery : EQueryFlags::None;
+	FQueryFilterData QueryFilterData = MakeQueryFilterData(Filter, QueryFlags, QueryParams);
+
+	// handles the ignored actors/components and the channel responses, same as the UWorld traces
+	FCollisionQueryFilterCallback QueryCallback(QueryParams, false);
+	QueryCallback.bIgnoreTouches = true;
+
+	// the face picks the material on triangle meshes and landscapes, like the UWorld traces do
+	EHitFlags OutputFlags = EHitFlags::Distance | EHitFlags::Normal;
+	OutputFlags |= QueryParams.bReturnPhysicalMaterial ? EHitFlags::FaceIndex : EHitFlags::None;
+
+	// NOTE(dennis): one read lock for the whole batch, the UWorld traces lock and unlock per segment
+	FPhysicsCommand::ExecuteRead(&Scene, [&]()
 	{
-		FHandleLookup A;
-		FProjectileHandleLookup B;
-	} Cast = { .B = *Lookup };
+		for (uint32 I = 0; I < Count; ++I)
+		{
+			FProjectileHit& Out = OutHits[I];
+			Out = {};
+			Out.Time = 1.0f;
+
+			FVector Delta = Ends[I] - Starts[I];
+			float DeltaMag = (float)Delta.Size();
+			if (DeltaMag <= UE_KINDA_SMALL_NUMBER)
+			{
+				continue;
+			}
+
+			FSingleHitBuffer<FHitRaycast> HitBuffer;
+			LowLevelRaycast(Scene, Starts[I], Delta / DeltaMag, DeltaMag, HitBuffer, OutputFlags, QueryFlags,
+				Filter, QueryFilterData, &QueryCallback);
 
-	return Cast.A;
+			if (HitBuffer.HasBlockingHit())
+			{
+				const FHitRaycast& Hit = *HitBuffer.GetBlock();
+				Out.Time = FMath::Clamp(Hit.Distance / DeltaMag, 0.0f, 1.0f);
+				Out.Normal = FVector3f(Hit.WorldNormal);
+				Out.bBlockingHit = true;
+				Out.bStartPenetrating = Hit.Distance <= 0.0f;
+				// NOTE(dennis): Hit.Actor/Hit.Shape are never turned into a component, FProjectileHit has no room for one
+
+				// the surface type picks the ricochet and penetration rules
+				if (QueryParams.bReturnPhysicalMaterial && Hit.Shape && Hit.Actor)
+				{
+					const FPhysicsMaterial* Material = ChaosInterface::GetMaterialFromInternalFaceIndex(*Hit.Shape, *Hit.Actor, Hit.FaceIndex);
+					UPhysicalMaterial* PhysMaterial = Material ? GetUserData(*Material) : nullptr;
+					Out.SurfaceType = (uint8)UPhysicalMaterial::DetermineSurfaceType(PhysMaterial);
+				}
+			}
+		}
+	});
 }
 
-struct BumpAllocator
+void FProjectileWorldCollision::TraceSegmentsWorld(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+	EProjectileTraceType Type)
 {
-	uint32 Pos;
+	// static/dynamic traces go by object type, the regular trace by the projectile channel responses
+	static const FCollisionObjectQueryParams StaticObjects(FCollisionObjectQueryParams::AllStaticObjects);
+	static const FCollisionObjectQueryParams DynamicObjects(FCollisionObjectQueryParams::AllDynamicObjects);
 
-	template<typename T>
-	uint32 Bump(uint32 Count = 1)
+	// NOTE(dennis): scene queries are safe off the game thread, it's what async traces do as well
+	for (uint32 I = 0; I < Count; ++I)
 	{
-		uint32 AlignedPos = Align(Pos, alignof(T));
-		uint32 Bytes = sizeof(T) * Count;
-		Pos += Bytes;
-		return AlignedPos;
+		FHitResult Hit;
+		// NOTE(dennis): use a Shape cast if you need larger projectiles
+		switch (Type)
+		{
+		case EProjectileTraceType::All:
+			World->LineTraceSingleByChannel(Hit, Starts[I], Ends[I], ECC_WorldDynamic, QueryParams);
+			break;
+		case EProjectileTraceType::Static:
+			World->LineTraceSingleByObjectType(Hit, Starts[I], Ends[I], StaticObjects, QueryParams);
+			break;
+		case EProjectileTraceType::Dynamic:
+			World->LineTraceSingleByObjectType(Hit, Starts[I], Ends[I], DynamicObjects, QueryParams);
+			break;
+		}
+
+		FProjectileHit& Out = OutHits[I];
+		Out.Time = Hit.Time;
+		Out.Normal = FVector3f(Hit.ImpactNormal);
+		Out.SurfaceType = (uint8)UPhysicalMaterial::DetermineSurfaceType(Hit.PhysMaterial.Get());
+		Out.bBlockingHit = Hit.bBlockingHit;
+		Out.bStartPenetrating = Hit.bStartPenetrating;
 	}
-};
+}
 
-static FProjectileChunk CreateProjectileChunk(UProjectileConfig* Config)
+void FProjectileWorldCollision::DrawDebugLine(const FVector& Start, const FVector& End, const FColor& Color)
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE(CreateProjectileChunk);
+	DebugLines.Add(Start, End, Color);
+}
 
-	FProjectileChunk Chunk = {};
-	Chunk.Config = Config;
-	Chunk.Count = 0;
+void FProjectileWorldCollision::FlushDebugLines()
+{
+	DebugLines.Flush(World);
+}
 
-	// figure out memory size requirements and the offsets to each array inside of that block
-	BumpAllocator Alloc = { 0 };
-	uint32 StatesOffset = Alloc.Bump<FProjectileChunk>(MAX_CHUNK_PROJECTILE_COUNT);
-	uint32 HandlesOffset = Alloc.Bump<FProjectileHandle>(MAX_CHUNK_PROJECTILE_COUNT);
+void FProjectileWorldCollision::FlushTraceStats()
+{
+	if (TraceRays > 0)
+	{
+		TRACE_COUNTER_SET(ProjectileNsPerRay, FPlatformTime::ToMilliseconds64(TraceCycles) * 1000000.0 / (double)TraceRays);
+	}
 
-	// allocate a single memory block to fit everything
-	uint32 DataAlignment = (uint32)FPlatformMemory::GetConstants().PageSize;
-	uint8* DataPtr = (uint8*)FMemory::MallocZeroed(Alloc.Pos, DataAlignment);
-	Chunk.DataPtr = DataPtr;
+	TraceCycles = 0;
+	TraceRays = 0;
+}
 
-	// assign the pointers
-	Chunk.States = (FProjectileState*)(DataPtr + StatesOffset);
-	Chunk.Handles = (FProjectileHandle*)(DataPtr + HandlesOffset);
+FProjectileDebugLineBuffer::FProjectileDebugLineBuffer()
+	: MaxLines(0)
+{
+}
 
-	return Chunk;
+void FProjectileDebugLineBuffer::Init(int32 InMaxLines)
+{
+	MaxLines = FMath::Max(InMaxLines, 0);
+	Lines.Empty(MaxLines);
 }
 
-static void DestroyProjectileChunk(FProjectileChunk* Chunk)
+void FProjectileDebugLineBuffer::Add(const FVector& Start, const FVector& End, const FColor& Color)
 {
-	FMemory::Free(Chunk->DataPtr);
-	*Chunk = {};
+	if (Lines.Num() < MaxLines)
+	{
+		Lines.Emplace(Start, End, FLinearColor(Color), 1.0f, 0.0f, SDPG_World);
+	}
+}
+
+void FProjectileDebugLineBuffer::Flush(UWorld* World)
+{
+#if ENABLE_DRAW_DEBUG
+	// one render state update for the whole frame, not one per line
+	if (Lines.Num() > 0 && World && World->LineBatcher)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(FProjectileDebugLineBuffer::Flush);
+		World->LineBatcher->DrawLines(Lines);
+	}
+#endif // ENABLE_DRAW_DEBUG
+
+	// keeps the allocation
+	Lines.Reset();
 }
 
 UProjectileSubsystem::UProjectileSubsystem()
 	: Super()
+	, StreamingCheckTimer(0.0f)
 {
-	PrimaryTickFunction.Subsystem = this;
-	PrimaryTickFunction.TickGroup = TG_PrePhysics;
-	PrimaryTickFunction.bCanEverTick = true;
-	PrimaryTickFunction.bStartWithTickEnabled = true;
+	SubmitTickFunction.Subsystem = this;
+	SubmitTickFunction.bCanEverTick = true;
+	SubmitTickFunction.bStartWithTickEnabled = true;
+
+	ConsumeTickFunction.Subsystem = this;
+	ConsumeTickFunction.bCanEverTick = true;
+	ConsumeTickFunction.bStartWithTickEnabled = true;
 }
 
-int32 UProjectileSubsystem::GetOrCreateChunk(UProjectileConfig* Config)
+uint16 UProjectileSubsystem::GetOrAddConfigId(UProjectileConfig* Config)
 {
-	// find an existing chunk with enough space
-	for (int32 I = 0; I < Chunks.Num(); ++I)
+	if (uint16* Id = ConfigIds.Find(Config))
 	{
-		FProjectileChunk& It = Chunks[I];
-		if (It.Config == Config && It.Count < MAX_CHUNK_PROJECTILE_COUNT)
-		{
-			return I;
-		}
+		return *Id;
+	}
+
+	uint16 Id = Simulation.AddConfig(Config->GetSimParams());
+	check(Id == Configs.Num());
+	Configs.Add(Config);
+	ConfigIds.Add(Config, Id);
+
+	// a config without a budget allocates on demand, so the handle table can't stay sized from the budgets.
+	// safe with a tick in flight, the sweep task never touches the handle table
+	if (Config->ExpectedPeakCount <= 0)
+	{
+		Simulation.HandleTable.Grow(MAX_PROJECTILE_HANDLES);
 	}
 
-	// or create a new chunk if we couldn't find a suitable one
-	FProjectileChunk Tmp = CreateProjectileChunk(Config);
-	int32 Index = Chunks.Add(MoveTemp(Tmp));
-	return Index;
+	return Id;
 }
 
 FProjectileHandle UProjectileSubsystem::CreateProjectile(UProjectileConfig* Config,
-	const FVector& Location, const FRotator& Rotation)
+	const FVector& Location, const FRotator& Rotation, uint16 OwnerId)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::CreateProjectile);
 
-	// creating a projectile is as simple as grabbing a new handle,
-	// finding the chunk the projectile needs to go into,
-	// incrementing the chunk counter, which also gives us the index in that chunk,
-	// which finally gives us the lookup data.
-	// then just get the state and initialize the projectile data.
-	// done.
-	
-	FProjectileHandle Handle = HandleTable.Claim();
-	FHandleLookup* LookupPtr = HandleTable.Get(Handle);
-	FProjectileHandleLookup Lookup = UnpackHandleLookup(LookupPtr);
-
-	// find an existing chunk with enough space
-	// or create a new chunk if we couldn't find a suitable one
-	int32 ChunkIndex = GetOrCreateChunk(Config);
-	
-	FProjectileChunk *Chunk = &Chunks[ChunkIndex];
-
-	// increment the counter to get the index
-	uint32 IndexInChunk = Chunk->Count++;
-
-	// initialize the projectile
-	FProjectileState* State = Chunk->States + IndexInChunk;
-	*State = {};
-
-	State->Position = Location;
-	State->Rotation = FRotator3f(Rotation);
-	State->Velocity = FRotator3f(Rotation).Vector() * Config->InitialSpeed;
-	State->Lifetime = 0.0f;
-
-	// update the handle lookup data
-	Lookup.Chunk = (uint8)ChunkIndex;
-	Lookup.Index = (uint8)IndexInChunk;
-	*LookupPtr = PackHandleLookup(&Lookup);
-
-	Chunk->Handles[IndexInChunk] = Handle;
+	uint16 ConfigId = GetOrAddConfigId(Config);
+	FProjectileHandle Handle = Simulation.CreateProjectile(ConfigId, Location, Rotation, OwnerId);
+
+	// rejected spawns aren't recorded, playback could accept them and diverge from this run
+	if (Recorder && Simulation.IsProjectileValid(Handle))
+	{
+		Recorder->RecordSpawn(Config, Location, Rotation);
+	}
 
 	return Handle;
 }
 
 void UProjectileSubsystem::DestroyProjectile(FProjectileHandle Handle)
 {
-	if (HandleTable.IsValid(Handle))
-	{
-		TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::DestroyProjectile);
-
-		// when destroying a projectile, we don't want "gaps" in the array.
-		// destroy a projectile by just swapping the last projectile in the array
-		// and decrement the counter
-		//
-		// |P1|P2|P3|P4|
-		// ------------> count: 4
-		//
-		// destroying P2 creates a "gap" in the array
-		// |P1|  |P3|P4|
-		// ------------> count: 4
-		// 
-		// so we move P4 into that slot instead to fill it and decrement the counter
-		// |P1|P4|P3|  |
-		// --------> count: 3
-		//
-		// this requires us to update the handle lookup for P4 to point into index 2
-		//
-		// TODO(dennis): in theory we would also want a compaction step to keep each chunk compact
-		// we might have two chunks with the exact same config with a low count in each
-		// this should be packed to fill one of the chunks, basically move from one chunk to another
-
-		FHandleLookup* ThisLookupPtr = HandleTable.Get(Handle);
-		FProjectileHandleLookup ThisLookup = UnpackHandleLookup(ThisLookupPtr);
-		FProjectileChunk *Chunk = &Chunks[ThisLookup.Chunk];
-
-		check(!Chunk->bInsideTick);
-
-		// decrement the projectile counter
-		uint32 LastProjIndex = --Chunk->Count;
-		// get the last handle + lookup in this chunk that we are going to swap with
-		FProjectileHandle LastHandle = Chunk->Handles[LastProjIndex];
-		FHandleLookup* LastLookupPtr = HandleTable.Get(LastHandle);
-		// move the lookup so the last index handle now points to the destroyed projectile slot
-		*LastLookupPtr = *ThisLookupPtr;
-
-		FProjectileState* ThisState = Chunk->States + ThisLookup.Index;
-		FProjectileState* LastState = Chunk->States + LastProjIndex;
-		// move the projectile state from the last index to the destroyed index
-		*ThisState = *LastState;
-
-		FProjectileHandle* ThisHandlePtr = Chunk->Handles + ThisLookup.Index;
-		FProjectileHandle* LastHandlePtr = Chunk->Handles + LastProjIndex;
-		// finally move the handles array in the chunk
-		*ThisHandlePtr = *LastHandlePtr;
-
-		HandleTable.Release(Handle);
-	}
+	Simulation.DestroyProjectile(Handle);
 }
 
 FProjectileState* UProjectileSubsystem::GetProjectileState(FProjectileHandle Handle)
 {
-	if (HandleTable.IsValid(Handle))
+	return Simulation.GetProjectileState(Handle);
+}
+
+bool UProjectileSubsystem::IsProjectileValid(FProjectileHandle Handle) const
+{
+	return Simulation.IsProjectileValid(Handle);
+}
+
+AActorProjectile* UProjectileSubsystem::PromoteProjectile(FProjectileHandle Handle, TSubclassOf<AActorProjectile> Class)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::PromoteProjectile);
+
+	// the states belong to the sweep task until the consume tick
+	FinishTick();
+
+	FProjectileState State;
+	uint16 ConfigId;
+	uint16 OwnerId;
+	if (!Simulation.RemoveProjectile(Handle, EProjectileDestroyReason::Promoted, State, ConfigId, OwnerId))
+	{
+		return nullptr;
+	}
+
+	UActorProjectilePool* Pool = UActorProjectilePool::Get(GetWorld());
+	check(Pool);
+
+	FTransform SpawnTM(FRotator(State.Rotation), State.Position);
+	AActorProjectile* Actor = Pool->Acquire(Class ? Class : AActorProjectile::StaticClass(), Configs[ConfigId], SpawnTM, nullptr);
+	Actor->ContinueFromState(State);
+	return Actor;
+}
+
+FProjectileHandle UProjectileSubsystem::DemoteProjectile(AActorProjectile* Actor, uint16 OwnerId)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::DemoteProjectile);
+
+	check(IsValid(Actor) && Actor->Config);
+
+	// NOTE(dennis): not recorded, playback only knows about fresh spawns
+	FProjectileState State = Actor->GetProjectileState();
+	FProjectileHandle Handle = Simulation.CreateProjectileFromState(GetOrAddConfigId(Actor->Config), State, OwnerId);
+
+	if (Simulation.IsProjectileValid(Handle))
+	{
+		Actor->Expire();
+	}
+
+	return Handle;
+}
+
+void UProjectileSubsystem::DrawActorDebugLine(const FVector& Start, const FVector& End, const FColor& Color)
+{
+	ActorDebugLines.Add(Start, End, Color);
+}
+
+void UProjectileSubsystem::QueryRadius(const FVector& Center, float Radius, TArray<FProjectileHandle>& OutHandles)
+{
+	Simulation.QueryRadius(Center, Radius, OutHandles);
+}
+
+void UProjectileSubsystem::QueryBox(const FBox& Box, TArray<FProjectileHandle>& OutHandles)
+{
+	Simulation.QueryBox(Box, OutHandles);
+}
+
+void UProjectileSubsystem::QuerySegment(const FVector& Start, const FVector& End, float Radius, TArray<FProjectileHandle>& OutHandles)
+{
+	Simulation.QuerySegment(Start, End, Radius, OutHandles);
+}
+
+uint16 UProjectileSubsystem::RegisterOwner(IProjectileOwner* Owner)
+{
+	check(Owner);
+
+	if (FreeOwnerIds.Num() > 0)
+	{
+		uint16 OwnerId = FreeOwnerIds.Pop(false);
+		Owners[OwnerId] = Owner;
+		return OwnerId;
+	}
+
+	check(Owners.Num() <= TNumericLimits<uint16>::Max());
+	return (uint16)Owners.Add(Owner);
+}
+
+void UProjectileSubsystem::UnregisterOwner(uint16 OwnerId)
+{
+	if (OwnerId != 0 && Owners.IsValidIndex(OwnerId) && Owners[OwnerId])
+	{
+		Owners[OwnerId] = nullptr;
+
+		// nothing may reach whoever gets this id next, not even events that are being dispatched right now
+		Simulation.ClearOwner(OwnerId);
+		for (FProjectileDestroyEvent& Event : DispatchEvents)
+		{
+			if (Event.OwnerId == OwnerId)
+			{
+				Event.OwnerId = 0;
+			}
+		}
+
+		// or explosions that are being resolved, the owner can be unregistered by the damage they do
+		for (FProjectileExplosionCluster& Cluster : ExplosionClusters)
+		{
+			if (Cluster.OwnerId == OwnerId)
+			{
+				Cluster.OwnerId = 0;
+			}
+		}
+
+		FreeOwnerIds.Add(OwnerId);
+	}
+}
+
+uint16 UProjectileSubsystem::RegisterTarget(AActor* Actor)
+{
+	check(Actor);
+
+	uint16 TargetId = Simulation.AddTarget(Actor->GetActorLocation());
+	if (TargetId == 0)
+	{
+		UE_LOG(LogProjectile, Warning, TEXT("Too many projectile targets, ignoring '%s'"), *Actor->GetName());
+		return 0;
+	}
+
+	if (TargetActors.Num() <= TargetId)
+	{
+		TargetActors.SetNum(TargetId + 1);
+	}
+
+	TargetActors[TargetId] = Actor;
+	return TargetId;
+}
+
+void UProjectileSubsystem::UnregisterTarget(uint16 TargetId)
+{
+	if (TargetId != 0 && TargetActors.IsValidIndex(TargetId))
+	{
+		TargetActors[TargetId] = nullptr;
+		Simulation.RemoveTarget(TargetId);
+	}
+}
+
+void UProjectileSubsystem::UpdateTargets()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::UpdateTargets);
+
+	for (int32 TargetId = 1; TargetId < TargetActors.Num(); ++TargetId)
+	{
+		if (AActor* Actor = TargetActors[TargetId].Get())
+		{
+			Simulation.SetTargetLocation((uint16)TargetId, Actor->GetActorLocation());
+		}
+		else if (!TargetActors[TargetId].IsExplicitlyNull())
+		{
+			// destroyed without unregistering
+			UnregisterTarget((uint16)TargetId);
+		}
+	}
+}
+
+void UProjectileSubsystem::DispatchDestroyEvents()
+{
+	if (Simulation.DestroyEvents.Num() == 0)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::DispatchDestroyEvents);
+
+	// owners are free to create/destroy projectiles from the callback,
+	// so take the events out of the simulation before handing them out
+	Swap(DispatchEvents, Simulation.DestroyEvents);
+
+	// group by owner so every owner gets exactly one call
+	DispatchEvents.StableSort([](const FProjectileDestroyEvent& A, const FProjectileDestroyEvent& B)
+	{
+		return A.OwnerId < B.OwnerId;
+	});
+
+	int32 EventCount = DispatchEvents.Num();
+	for (int32 First = 0; First < EventCount;)
+	{
+		uint16 OwnerId = DispatchEvents[First].OwnerId;
+
+		int32 Last = First + 1;
+		while (Last < EventCount && DispatchEvents[Last].OwnerId == OwnerId)
+		{
+			++Last;
+		}
+
+		if (IProjectileOwner* Owner = Owners[OwnerId])
+		{
+			Owner->OnProjectilesDestroyed(MakeArrayView(DispatchEvents.GetData() + First, Last - First));
+		}
+
+		First = Last;
+	}
+
+	DispatchEvents.Reset();
+}
+
+void UProjectileSubsystem::StartRecording(const FString& Filename)
+{
+	StopRecording();
+
+	Recorder = MakeUnique<FProjectileRecorder>();
+	if (Recorder->Start(Filename))
 	{
-		FProjectileHandleLookup Lookup = UnpackHandleLookup(HandleTable.Get(Handle));
-		FProjectileChunk* Chunk = &Chunks[Lookup.Chunk];
-		FProjectileState* State = Chunk->States + Lookup.Index;
-		return State;
+		UE_LOG(LogProjectile, Log, TEXT("Recording projectiles to '%s'"), *Filename);
 	}
 	else
 	{
-		// if the handle is invalid, we still return a valid pointer to something
-		// so that the caller can continue as normal without doing any error checking
-		// if the wish to actually make sure that the projectile is valid, then they should use
-		// UProjectileSubsystem::IsProjectileValid
-		static FProjectileState GStubState;
-		return &GStubState;
+		Recorder.Reset();
 	}
 }
 
-bool UProjectileSubsystem::IsProjectileValid(FProjectileHandle Handle) const
+void UProjectileSubsystem::StopRecording()
 {
-	return HandleTable.IsValid(Handle);
+	if (Recorder)
+	{
+		Recorder->Stop();
+		Recorder.Reset();
+	}
 }
 
 void UProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
@@ -263,7 +524,35 @@ void UProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 	Super::Initialize(Collection);
 	OnWorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UProjectileSubsystem::OnWorldCleanup);
 
-	HandleTable.Init(MAX_PROJECTILE_HANDLES); 
+	if (FixedTimestep < MinFixedTimestep)
+	{
+		UE_LOG(LogProjectile, Warning, TEXT("Projectile FixedTimestep %f is too small, using %f"), FixedTimestep, MinFixedTimestep);
+		FixedTimestep = MinFixedTimestep;
+	}
+
+	Simulation.bDeterministic = bDeterministic;
+	Simulation.FixedTimestep = FixedTimestep;
+	Simulation.MaxRetargetsPerFrame = (uint32)FMath::Max(MaxRetargetsPerFrame, 0);
+	Simulation.MaxChunkSortsPerFrame = (uint32)FMath::Max(MaxChunkSortsPerFrame, 0);
+	Simulation.SpatialIndex.CellSize = FMath::Max(SpatialIndexCellSize, 1.0f);
+	Simulation.bPublishSnapshots = bPublishSnapshots;
+	Simulation.SaturationHeadroom = (uint32)FMath::Clamp(SaturationHeadroom, 0, MAX_PROJECTILE_HANDLES);
+	Simulation.ReservedPriority = (uint8)FMath::Clamp(ReservedPriority, 0, 255);
+	Simulation.Init(MAX_PROJECTILE_HANDLES);
+
+	Collision.World = GetWorld();
+	Collision.DebugLines.Init(MaxDebugLinesPerFrame);
+	Collision.bDirectSceneQueries = bDirectSceneQueries;
+	ActorDebugLines.Init(MaxDebugLinesPerFrame);
+
+	// owner id 0 means no owner
+	Owners.Reset();
+	Owners.Add(nullptr);
+	FreeOwnerIds.Reset();
+
+	// target id 0 means no target
+	TargetActors.Reset();
+	TargetActors.Add(nullptr);
 }
 
 void UProjectileSubsystem::Deinitialize()
@@ -271,11 +560,15 @@ void UProjectileSubsystem::Deinitialize()
 	FWorldDelegates::OnWorldCleanup.Remove(OnWorldCleanupHandle);
 	OnWorldCleanupHandle = {};
 
-	// cleanup all chunks
-	for (FProjectileChunk& It : Chunks)
-	{
-		DestroyProjectileChunk(&It);
-	}
+	FinishTick();
+	StopRecording();
+
+	Simulation.Shutdown();
+	Configs.Reset();
+	ConfigIds.Reset();
+	Owners.Reset();
+	FreeOwnerIds.Reset();
+	TargetActors.Reset();
 
 	Super::Deinitialize();
 }
@@ -284,180 +577,300 @@ void UProjectileSubsystem::OnWorldBeginPlay(UWorld& InWorld)
 {
 	if (InWorld.IsGameWorld())
 	{
-		PrimaryTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+		SubmitTickFunction.TickGroup = SubmitTickGroup;
+		SubmitTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+
+		if (bAsyncSweep)
+		{
+			// everything between the two tick groups runs while the sweeps are in flight
+			ConsumeTickFunction.TickGroup = FMath::Max(ConsumeTickGroup.GetValue(), SubmitTickGroup.GetValue());
+			ConsumeTickFunction.AddPrerequisite(this, SubmitTickFunction);
+			ConsumeTickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+		}
+
+		ReserveLevelConfigs(InWorld);
+
+		// the simulation only tracks where its projectiles are when something is going to check them
+		Simulation.StreamingCellSize = bStreamingAware && InWorld.IsPartitionedWorld() ? FMath::Max(StreamingCellSize, 100.0f) : 0.0f;
+		StreamingCheckTimer = 0.0f;
 	}
 }
 
-void UProjectileSubsystem::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+void UProjectileSubsystem::ReserveConfig(UProjectileConfig* Config)
 {
-	PrimaryTickFunction.UnRegisterTickFunction();
+	if (!Config || Config->ExpectedPeakCount <= 0)
+	{
+		return;
+	}
+
+	// the sweep task appends to the scratch arrays that get reserved
+	FinishTick();
+
+	Simulation.ReserveProjectiles(GetOrAddConfigId(Config), (uint32)Config->ExpectedPeakCount);
+
+	// the handle table is sized from the budgets once every registered config has one
+	int64 BudgetCount = 0;
+	for (UProjectileConfig* It : Configs)
+	{
+		if (It->ExpectedPeakCount <= 0)
+		{
+			return;
+		}
+		BudgetCount += It->ExpectedPeakCount;
+	}
+
+	uint32 HandleCount = Simulation.ReserveHandles((uint32)FMath::Min<int64>(BudgetCount, MAX_PROJECTILE_HANDLES));
+	DispatchEvents.Reserve(HandleCount);
+	ResolvingExplosions.Reserve(HandleCount);
 }
 
-static FVector3f CalcProjectileVelocity(float DeltaTime, FVector3f V0, float MaxSpeed, float GravityZ)
+void UProjectileSubsystem::ReserveLevelConfigs(UWorld& InWorld)
 {
-	// v = v0 + a*t
-	FVector3f Acc = FVector3f(0.0f, 0.0f, GravityZ);
-	FVector3f V1 = V0 + (Acc * DeltaTime);
-	if (MaxSpeed > 0.0f)
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::ReserveLevelConfigs);
+
+	// NOTE(dennis): spawners are the only thing placed in levels that fires projectiles,
+	// anything else has to call ReserveConfig itself
+	TSet<UProjectileConfig*> LevelConfigs;
+	for (TActorIterator<AProjectileSpawner> It(&InWorld); It; ++It)
 	{
-		V1 = V1.GetClampedToMaxSize(MaxSpeed);
+		LevelConfigs.Add(It->Config);
+		for (const FProjectileFirePattern& Pattern : It->FirePatterns)
+		{
+			LevelConfigs.Add(Pattern.Config);
+		}
 	}
 
-	return V1;
+	int64 ExpectedCount = 0;
+	for (UProjectileConfig* Config : LevelConfigs)
+	{
+		if (Config)
+		{
+			ReserveConfig(Config);
+			ExpectedCount += FMath::Max(Config->ExpectedPeakCount, 0);
+		}
+	}
+
+	UE_LOG(LogProjectile, Log, TEXT("Projectile budget: %lld expected projectiles over %d configs, %d chunks, %.2f MiB committed, %u handles"),
+		ExpectedCount, Configs.Num(), Simulation.Chunks.Num(), (double)Simulation.GetAllocatedBytes() / (1024.0 * 1024.0),
+		Simulation.HandleTable.MaxCount);
+
+	// the table is clamped to what a handle can address, past that spawns run out of handles
+	if (ExpectedCount > MAX_PROJECTILE_HANDLES)
+	{
+		UE_LOG(LogProjectile, Warning, TEXT("Expected projectile count %lld exceeds the %d projectile handles there can be"),
+			ExpectedCount, MAX_PROJECTILE_HANDLES);
+	}
 }
 
-void UProjectileSubsystem::Tick(float DeltaTime)
+void UProjectileSubsystem::UpdateEvictionFocus()
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::Tick);
+	Simulation.EvictionFocus.Reset();
 
-	UWorld* World = GetWorld();
-	check(World);
+	// only looked at when something is about to be evicted
+	if (Simulation.HandleTable.GetFreeCount() >= Simulation.SaturationHeadroom)
+	{
+		return;
+	}
 
-	float GravityZ = World->GetGravityZ();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (APlayerController* Controller = It->Get())
+		{
+			FVector Location;
+			FRotator Rotation;
+			Controller->GetPlayerViewPoint(Location, Rotation);
+			Simulation.EvictionFocus.Add(Location);
+		}
+	}
+}
 
-	// number of update iterations we need to run
-	uint32 SubstepCount = (uint32)FMath::CeilToInt(DeltaTime / MAX_PROJECTILE_TIMESTEP);
-	SubstepCount = FMath::Min<uint32>(SubstepCount, MAX_PROJECTILE_SUBSTEP);
+void UProjectileSubsystem::UpdateUnloadedCells(float DeltaTime)
+{
+	if (Simulation.StreamingCellSize <= 0.0f)
+	{
+		return;
+	}
 
-	uint32 ChunkCount = (uint32)Chunks.Num();
-	for (uint32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+	StreamingCheckTimer -= DeltaTime;
+	if (StreamingCheckTimer > 0.0f)
 	{
-		TRACE_CPUPROFILER_EVENT_SCOPE(TickProjectileChunk);
+		return;
+	}
+
+	StreamingCheckTimer = StreamingCheckInterval;
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::UpdateUnloadedCells);
+
+	Simulation.UnloadedCells.Reset();
 
-		FProjectileChunk* Chunk = &Chunks[ChunkIndex];
-		UProjectileConfig* Config = Chunk->Config;
-		
-		// projectile that should be destroyed this frame
-		// it's not safe to destroy projectiles while we are updating them so it needs to be deferred
-		// we also don't want to trash the cpu cache with destruction
-		static FProjectileHandle DestroyHandles[MAX_CHUNK_PROJECTILE_COUNT];
-		uint32 DestroyHandlesCount = 0;
+	const UWorldPartitionSubsystem* WorldPartition = GetWorld()->GetSubsystem<UWorldPartitionSubsystem>();
+	if (!WorldPartition)
+	{
+		return;
+	}
 
-		// input & output to the second stage
-		static FVector3f MoveDeltas[MAX_CHUNK_PROJECTILE_COUNT];
-		static FHitResult Hits[MAX_CHUNK_PROJECTILE_COUNT];
+	// one query per cell with projectiles in it, a sphere around the cell asks whether every
+	// runtime cell under it is activated. the runtime grids are 2D, so is the projectile cell
+	float CellSize = Simulation.StreamingCellSize;
+	TArray<FWorldPartitionStreamingQuerySource> QuerySources;
+	FWorldPartitionStreamingQuerySource& Source = QuerySources.AddDefaulted_GetRef();
+	Source.bUseGridLoadingRange = false;
+	Source.Radius = CellSize * UE_HALF_SQRT_2;
 
-		FCollisionQueryParams QueryParams(TEXT("Projectile"), false, NULL);
-		QueryParams.bReturnFaceIndex = false;
-		
-		for (uint32 Step = 0; Step < SubstepCount; ++Step)
+	for (const FIntPoint& Cell : Simulation.OccupiedCells)
+	{
+		Source.Location = FVector((Cell.X + 0.5f) * CellSize, (Cell.Y + 0.5f) * CellSize, 0.0f);
+		if (!WorldPartition->IsStreamingCompleted(EWorldPartitionRuntimeCellState::Activated, QuerySources, false))
 		{
-			TRACE_CPUPROFILER_EVENT_SCOPE(Substep);
+			Simulation.UnloadedCells.Add(Cell);
+		}
+	}
+}
+
+void UProjectileSubsystem::ResolveExplosions()
+{
+	if (Simulation.Explosions.Num() == 0)
+	{
+		return;
+	}
 
-			// this prevents dangerous functions like Destroy Projectile from being called while
-			// we are updating the projectiles
-			Chunk->bInsideTick = true;
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::ResolveExplosions);
 
-			float StepDt = DeltaTime / (float)SubstepCount;
-			uint32 ProjCount = Chunk->Count;
+	// damage can destroy actors that spawn or destroy projectiles, take the explosions out first
+	Swap(ResolvingExplosions, Simulation.Explosions);
 
-			// projectile are updated in 3 stages:
-			// 1. compute the MoveDelta to use for the sweep stage
-			// 2. perform hit sweeps
-			// 3. handle hit result and compute final velocity
+	ClusterProjectileExplosions(ResolvingExplosions, MaxExplosionClusterRadius, ExplosionClusters, ExplosionClusterIndices, ExplosionMembers);
 
-			// calculate MoveDelta
-			for (uint32 I = 0; I < ProjCount; ++I)
+	UWorld* World = GetWorld();
+	static const FCollisionObjectQueryParams AllObjects(FCollisionObjectQueryParams::AllObjects);
+	FCollisionQueryParams OverlapParams(TEXT("ProjectileExplosion"), false);
+
+	for (const FProjectileExplosionCluster& Cluster : ExplosionClusters)
+	{
+		UProjectileConfig* Config = Configs[Cluster.ConfigId];
+
+		// looked up per cluster, the damage of an earlier cluster can unregister the owner
+		IProjectileOwner* Owner = Owners.IsValidIndex(Cluster.OwnerId) ? Owners[Cluster.OwnerId] : nullptr;
+		AActor* Causer = Owner ? Owner->GetProjectileDamageCauser() : nullptr;
+
+		// one query for the whole cluster, every member explosion is resolved against its results
+		ExplosionOverlaps.Reset();
+		World->OverlapMultiByObjectType(ExplosionOverlaps, Cluster.Center, FQuat::Identity, AllObjects,
+			FCollisionShape::MakeSphere(Cluster.Radius), OverlapParams);
+
+		ExplosionActors.Reset();
+		for (const FOverlapResult& Overlap : ExplosionOverlaps)
+		{
+			AActor* Actor = Overlap.GetActor();
+			UPrimitiveComponent* Component = Overlap.GetComponent();
+			if (Actor && Component && Actor->CanBeDamaged())
 			{
-				FProjectileState* State = Chunk->States + I;
-
-				// Velocity Verlet integration (http://en.wikipedia.org/wiki/Verlet_integration#Velocity_Verlet)
-				// The addition of p0 is done outside this method, we are just computing the delta.
-				// p = p0 + v0*t + 1/2*a*t^2
-				
-				// v = v0 + a*t
-				FVector3f Vel = CalcProjectileVelocity(StepDt, State->Velocity, Config->InitialSpeed, GravityZ);
-				// p = v0*t + 1/2*a*t^2
-				FVector3f Delta = (State->Velocity * StepDt) + (Vel - State->Velocity) * (0.5f * StepDt);
-
-				FRotator3f Rot = State->Rotation;
-				// branches using 'Config' is going to be 100% predictable
-				// since every single projectile in this Chunk use the exact same one
-				if (Config->bRotationFollowsVelocity)
-				{
-					// NOTE(dennis): this is actually  expensive
-					// 2x arctanf
-					// 1x sqrtf
-					Rot = Vel.Rotation();
-				}
-				
-				State->Rotation = Rot;
-				MoveDeltas[I] = Delta;
+				ExplosionActors.FindOrAdd(TObjectKey<AActor>(Actor), FBox(ForceInit)) += Component->Bounds.GetBox();
 			}
+		}
 
-			for (uint32 I = 0; I < ProjCount; ++I)
+		for (const TPair<TObjectKey<AActor>, FBox>& It : ExplosionActors)
+		{
+			// every explosion in the cluster adds its own falloff, the actor takes it as a single hit
+			float Damage = 0.0f;
+			for (uint32 I = 0; I < Cluster.MemberCount; ++I)
 			{
-				FProjectileState* State = Chunk->States + I;
-
-				FVector Start = State->Position;
-				FVector End = Start + FVector(MoveDeltas[I]);
-
-				// NOTE(dennis): use a Shape cast if you need larger projectiles
-				World->LineTraceSingleByChannel(Hits[I], Start, End, ECC_WorldDynamic, QueryParams);
+				const FProjectileExplosion& Explosion = ResolvingExplosions[ExplosionMembers[Cluster.FirstMember + I]];
+				float Distance = FMath::Sqrt((float)It.Value.ComputeSquaredDistanceToPoint(Explosion.Location));
+				Damage += Config->GetExplosionDamage(Distance);
 			}
 
-			// finalize velocity and handle hits
-			for (uint32 I = 0; I < ProjCount; ++I)
+			// damage to an earlier actor can take this one down, or the one who fired
+			AActor* Actor = It.Key.ResolveObjectPtr();
+			if (Damage > 0.0f && IsValid(Actor))
 			{
-				FProjectileState* State = Chunk->States + I;
-				FVector3f MoveDelta = MoveDeltas[I];
-				FHitResult Hit = Hits[I];
-				
-				bool bMarkForKill = false;
-				
-				// add p0 to the verlet integration from the first update
-				// p = p0 + v0*t + 1/2*a*t^2
-				FVector P0 = State->Position;
-				FVector P1 = P0 + FVector(MoveDelta * Hit.Time);
-
-				// v = v0 + a*t
-				FVector3f V0 = State->Velocity;
-				// take the hit time into account when calculating velocity
-				float VelTime = StepDt * Hit.Time;
-				FVector3f V1 = CalcProjectileVelocity(VelTime, V0, Config->InitialSpeed, GravityZ);
-
-				bool bHitSomething = Hit.bBlockingHit || Hit.bStartPenetrating;
-				if (bHitSomething)
-				{
-					bMarkForKill = true;
+				AActor* DamageCauser = IsValid(Causer) ? Causer : nullptr;
+				AController* Instigator = DamageCauser ? DamageCauser->GetInstigatorController() : nullptr;
+				UGameplayStatics::ApplyDamage(Actor, Damage, Instigator, DamageCauser, Config->ExplosionDamageType);
+			}
+		}
+	}
 
-					// TODO(dennis): here you handle projectile impact events
-				}
+	ResolvingExplosions.Reset();
+}
 
-#if ENABLE_DRAW_DEBUG
-				if (Config->bDebugDraw)
-				{
-					DrawDebugLine(World, P0, P1, FColor::Green, false, 1.0f);
-				}
-#endif // ENABLE_DRAW_DEBUG
+void UProjectileSubsystem::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	FinishTick();
 
-				State->Position = P1;
-				State->Velocity = V1;
+	SubmitTickFunction.UnRegisterTickFunction();
+	ConsumeTickFunction.UnRegisterTickFunction();
+}
 
-				State->Lifetime += StepDt;
-				// destroy projectile when lifetime exceeded
-				if (Config->MaxLifetime != 0.0f && State->Lifetime >= Config->MaxLifetime)
-				{
-					bMarkForKill = true;
-				}
+void UProjectileSubsystem::FinishTick()
+{
+	if (Simulation.bTickInFlight)
+	{
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::WaitForSweep);
+			SweepTask.Wait();
+		}
 
-				if (bMarkForKill)
-				{
-					FProjectileHandle Handle = Chunk->Handles[I];
-					DestroyHandles[DestroyHandlesCount++] = Handle;
-				}
-			}
+		Simulation.EndTick();
+		Collision.FlushDebugLines();
+		Collision.FlushTraceStats();
+	}
+}
 
-			// after we are done with the updating we can destroy the projectiles
-			Chunk->bInsideTick = false;
+void UProjectileSubsystem::SubmitTick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::SubmitTick);
 
-			for (uint32 I = 0; I < DestroyHandlesCount; ++I)
-			{
-				FProjectileHandle Handle = DestroyHandles[I];
-				DestroyProjectile(Handle);
-			}
+	UWorld* World = GetWorld();
+	check(World);
 
-			DestroyHandlesCount = 0;
-		}
+	// the consume tick didn't run last frame (paused or unregistered)
+	FinishTick();
+
+	// configs can be edited while playing, they are tiny so just copy them every frame
+	for (int32 I = 0; I < Configs.Num(); ++I)
+	{
+		Simulation.Configs[I] = Configs[I]->GetSimParams();
+	}
+
+	UpdateTargets();
+	UpdateUnloadedCells(DeltaTime);
+	UpdateEvictionFocus();
+
+	Collision.World = World;
+	Simulation.BeginTick(DeltaTime, World->GetGravityZ(), Collision);
+
+	if (bAsyncSweep)
+	{
+		SweepTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]
+		{
+			Simulation.SimulateTick();
+		});
+	}
+	else
+	{
+		Simulation.SimulateTick();
+		ConsumeTick(DeltaTime);
+	}
+}
+
+void UProjectileSubsystem::ConsumeTick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UProjectileSubsystem::ConsumeTick);
+
+	FinishTick();
+	ActorDebugLines.Flush(GetWorld());
+
+	ResolveExplosions();
+	DispatchDestroyEvents();
+
+	if (Simulation.bDeterministic)
+	{
+		UE_LOG(LogProjectile, VeryVerbose, TEXT("Projectile step %u hash %08x"), Simulation.StepNumber, Simulation.StateHash);
+	}
+
+	if (Recorder)
+	{
+		Recorder->CaptureFrame(*this, DeltaTime);
 	}
 }
@@ -3,14 +3,22 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "ProjectileHandle.h"
+#include "ProjectileSimulation.h"
+#include "ProjectileRecorder.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "Components/LineBatchComponent.h"
+#include "Engine/OverlapResult.h"
+#include "UObject/ObjectKey.h"
+#include "Physics/PhysicsFiltering.h"
 #include "ProjectileSubsystem.generated.h"
 
 class UProjectileConfig;
+class AActorProjectile;
 
+/** Early tick, integrates and kicks off the sweep work */
 USTRUCT()
-struct FProjectileTickFunction : public FTickFunction
+struct FProjectileSubmitTickFunction : public FTickFunction
 {
 	GENERATED_BODY()
 
@@ -19,51 +27,236 @@ struct FProjectileTickFunction : public FTickFunction
 	// ~ begin FTickFunction interface
 	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread,
 		const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override { return TEXT("FProjectileSubmitTickFunction"); }
 	// ~ end FTickFunction interface
 };
 
 template<>
-struct TStructOpsTypeTraits<FProjectileTickFunction>
-	: public TStructOpsTypeTraitsBase2<FProjectileTickFunction>
+struct TStructOpsTypeTraits<FProjectileSubmitTickFunction>
+	: public TStructOpsTypeTraitsBase2<FProjectileSubmitTickFunction>
 {
 	enum { WithCopy = false };
 };
 
-/** Per-projectile data which is updated for each simulation step */
-struct PROJECTILEPERF_API alignas(PLATFORM_CACHE_LINE_SIZE) FProjectileState
+/** Late tick, waits for the sweep work and destroys what got hit */
+USTRUCT()
+struct FProjectileConsumeTickFunction : public FTickFunction
 {
-	FVector				Position;		// world position
-	FRotator3f			Rotation;		// world rotation, float32 is enough
-	FVector3f			Velocity;		// world velocity, float32 is enough
-	float				Lifetime;		// time this projectile has been alive
-	// 12 bytes of padding available here
+	GENERATED_BODY()
+
+	UProjectileSubsystem* Subsystem;
+
+	// ~ begin FTickFunction interface
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread,
+		const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override { return TEXT("FProjectileConsumeTickFunction"); }
+	// ~ end FTickFunction interface
 };
 
-/** Main data container for projectiles */
-struct FProjectileChunk
+template<>
+struct TStructOpsTypeTraits<FProjectileConsumeTickFunction>
+	: public TStructOpsTypeTraitsBase2<FProjectileConsumeTickFunction>
 {
-	UProjectileConfig*	Config;			// shared config all these projectiles use
-	uint8*				DataPtr;		// pointer to the allocated memory block
-	FProjectileState*	States;			// per-projectile state
-	FProjectileHandle*	Handles;		// index to the handle for each projectile in the chunk
-	uint32				Count;			// number of projectiles in this chunk
-	bool				bInsideTick;	// this chunk is being updated (not safe to add/remove projectiles)
+	enum { WithCopy = false };
+};
+
+/**
+ * Debug lines collected over a frame and handed to the world's line batcher in one go,
+ * instead of a DrawDebugLine call (and render state update) per line
+ */
+struct FProjectileDebugLineBuffer
+{
+	TArray<FBatchedLine>		Lines;		// allocated once, lines past MaxLines are dropped
+	int32						MaxLines;
+
+	FProjectileDebugLineBuffer();
+
+	void Init(int32 InMaxLines);
+	void Add(const FVector& Start, const FVector& End, const FColor& Color);
+	/** submits and clears the lines. game thread only */
+	void Flush(UWorld* World);
+};
+
+/**
+ * Traces against the UWorld the subsystem lives in.
+ * Used from the sweep task, so debug lines are buffered and drawn on the game thread
+ */
+struct FProjectileWorldCollision : public IProjectileCollisionWorld
+{
+	UWorld*						World;
+	FCollisionQueryParams		QueryParams;
+	FProjectileDebugLineBuffer	DebugLines;		// drawn by FlushDebugLines
+
+	bool						bDirectSceneQueries;	// raycast the physics scene directly instead of going through UWorld
+	FCollisionFilterData		Filters[3];				// per EProjectileTraceType, built once for the direct queries
+
+	uint64						TraceCycles;	// spent in TraceSegments since the last FlushTraceStats
+	uint32						TraceRays;
+
+	FProjectileWorldCollision();
+
+	/** builds the filters the direct queries use, call again if QueryParams change */
+	void BuildQueryFilters();
+	/** publishes the average cost of a ray since the last call to insights */
+	void FlushTraceStats();
+
+	// ~ begin IProjectileCollisionWorld interface
+	virtual void TraceSegments(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+		EProjectileTraceType Type) override;
+	virtual void DrawDebugLine(const FVector& Start, const FVector& End, const FColor& Color) override;
+	// ~ end IProjectileCollisionWorld interface
+
+	/** draws the buffered debug lines. game thread only */
+	void FlushDebugLines();
+
+private:
+
+	/** the UWorld line trace path, one full collision query per segment */
+	void TraceSegmentsWorld(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+		EProjectileTraceType Type);
+	/** the direct path, one scene read lock for every segment and straight to the acceleration structure */
+	void TraceSegmentsDirect(const FVector* Starts, const FVector* Ends, uint32 Count, FProjectileHit* OutHits,
+		EProjectileTraceType Type);
+};
+
+/**
+ * Implemented by anything that owns actorless projectiles and wants to know when they are gone,
+ * instead of polling IsProjectileValid on every handle every frame
+ */
+class PROJECTILEPERF_API IProjectileOwner
+{
+public:
+
+	virtual ~IProjectileOwner() = default;
+
+	/** called once per frame after the projectile tick with every projectile of this owner
+		that was destroyed since the last call, for whatever reason */
+	virtual void OnProjectilesDestroyed(TArrayView<const FProjectileDestroyEvent> Events) = 0;
+
+	/** actor the explosions of this owner's projectiles are credited to, its instigator controller is the instigator.
+		null credits nobody */
+	virtual AActor* GetProjectileDamageCauser() { return nullptr; }
 };
 
 /**
  * Creates/Destroys/Updates Highly efficient "Actorless" Projectiles
  */
-UCLASS()
+UCLASS(Config=Game)
 class PROJECTILEPERF_API UProjectileSubsystem : public UWorldSubsystem
 {
 	GENERATED_BODY()
 	
 public:
 
-	TArray<FProjectileChunk>	Chunks;			// the main data storage for projectiles
-	FHandleTable				HandleTable;	// projectile handle data for external access
+	/** Run the simulation in lockstep: fixed timestep, deferred and ordered destroys, per-frame state hash.
+		Two runs fed with the same inputs (spawns/destroys per step) produce the same hash for every step */
+	UPROPERTY(Config)
+	uint32 bDeterministic:1;
+
+	/** Simulation step used when bDeterministic is enabled */
+	UPROPERTY(Config, Meta=(ForceUnits="s"))
+	float FixedTimestep = 1.0f / 60.0f;
+
+	/** Run the projectile sweeps in a task between the submit and consume ticks, overlapping them with
+		physics and other ticks. Otherwise the whole update runs in the submit tick */
+	UPROPERTY(Config)
+	uint32 bAsyncSweep:1 = true;
+
+	/** Raycast the physics scene directly with filters built once, a whole chunk under one scene lock, instead of
+		a UWorld line trace per projectile. Surface types are resolved from the hit shape like the UWorld traces do */
+	UPROPERTY(Config)
+	uint32 bDirectSceneQueries:1;
+
+	/** Tick group the submit tick integrates and kicks off the sweeps in */
+	UPROPERTY(Config)
+	TEnumAsByte<ETickingGroup> SubmitTickGroup = TG_PrePhysics;
+
+	/** Tick group the consume tick waits for the sweeps and destroys projectiles in */
+	UPROPERTY(Config)
+	TEnumAsByte<ETickingGroup> ConsumeTickGroup = TG_PostPhysics;
+
+	/** Number of homing projectiles that look for a new target per frame, over all projectiles */
+	UPROPERTY(Config)
+	int32 MaxRetargetsPerFrame = 256;
+
+	/** Chunks re-sorted per frame so projectiles next to each other in memory trace next to each other in the world.
+		0 keeps spawn order */
+	UPROPERTY(Config)
+	int32 MaxChunkSortsPerFrame = 4;
+
+	/** Grid cell size of the spatial index the projectile queries use. around the typical query radius works best */
+	UPROPERTY(Config, Meta=(ForceUnits="cm"))
+	float SpatialIndexCellSize = 500.0f;
+
+	/** Publish a copy of every projectile at the end of each frame that other threads (render, audio, ...) can read
+		without locks, see GetSnapshots. Holds the previous step too so visuals can interpolate between fixed steps */
+	UPROPERTY(Config)
+	uint32 bPublishSnapshots:1;
+
+	/** Debug lines buffered per frame for actorless projectiles, and again for actor projectiles.
+		The buffers are allocated up front, lines past this are dropped */
+	UPROPERTY(Config)
+	int32 MaxDebugLinesPerFrame = 65536;
+
+	/** Explosions are merged into clusters up to this radius, every cluster does a single overlap query */
+	UPROPERTY(Config, Meta=(ForceUnits="cm"))
+	float MaxExplosionClusterRadius = 1000.0f;
+
+	/** Projectiles in world partition cells that aren't loaded stop tracing, what they do instead is picked per config
+		(UProjectileConfig::UnloadedPolicy). They pick up where they are once the cell loads. No effect without world partition */
+	UPROPERTY(Config)
+	uint32 bStreamingAware:1;
+
+	/** Projectiles are grouped in cells this size and every cell with projectiles in it is checked against streaming.
+		Around the world partition grid cell size works best */
+	UPROPERTY(Config, Meta=(ForceUnits="cm"))
+	float StreamingCellSize = 12800.0f;
+
+	/** How often the cells with projectiles in them are checked against streaming */
+	UPROPERTY(Config, Meta=(ForceUnits="s"))
+	float StreamingCheckInterval = 0.25f;
+
+	/** Projectile handles kept free for configs of ReservedPriority and above. Once only this many are left lower
+		priority spawns are rejected, and lower priority projectiles with an evict policy are destroyed once per frame
+		to get it back. 0 keeps no headroom, spawns are only rejected once every handle is taken */
+	UPROPERTY(Config)
+	int32 SaturationHeadroom = 0;
 
-	FProjectileTickFunction		PrimaryTickFunction;
+	/** Priority a config needs to spawn into the headroom and to never be evicted, see UProjectileConfig::Priority */
+	UPROPERTY(Config, Meta=(UIMin="0", ClampMin="0", UIMax="255", ClampMax="255"))
+	int32 ReservedPriority = 128;
+
+	/** Configs registered with the simulation, indexed by FProjectileChunk::ConfigId */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UProjectileConfig>> Configs;
+
+	FProjectileSimulation		Simulation;		// chunks, handles and integration, knows nothing about the engine
+	TMap<UProjectileConfig*, uint16> ConfigIds;	// reverse lookup of Configs
+
+	TArray<IProjectileOwner*>	Owners;				// indexed by owner id, 0 is reserved for "no owner"
+	TArray<uint16>				FreeOwnerIds;		// unregistered owner ids that can be handed out again
+	TArray<FProjectileDestroyEvent> DispatchEvents;	// events being dispatched, kept around for the allocation
+
+	// explosions being resolved and their scratch buffers, kept around for the allocations
+	TArray<FProjectileExplosion>		ResolvingExplosions;
+	TArray<FProjectileExplosionCluster>	ExplosionClusters;
+	TArray<uint32>						ExplosionClusterIndices;
+	TArray<uint32>						ExplosionMembers;
+	TArray<FOverlapResult>				ExplosionOverlaps;
+	TMap<TObjectKey<AActor>, FBox>		ExplosionActors;	// overlapped actors of a cluster and the bounds of what was hit
+
+	TArray<TWeakObjectPtr<AActor>>	TargetActors;	// indexed by target id, their locations are pushed to the simulation every frame
+
+	TUniquePtr<FProjectileRecorder>	Recorder;	// streams every frame to disk while recording
+
+	float						StreamingCheckTimer;	// time left until the occupied cells are checked against streaming again
+
+	FProjectileWorldCollision	Collision;		// shared by the submit/consume ticks and the sweep task
+	UE::Tasks::FTask			SweepTask;		// simulates the tick in flight when bAsyncSweep
+	FProjectileDebugLineBuffer	ActorDebugLines;	// filled by actor projectiles on the game thread, flushed by the consume tick
+
+	FProjectileSubmitTickFunction	SubmitTickFunction;
+	FProjectileConsumeTickFunction	ConsumeTickFunction;
 	FDelegateHandle				OnWorldCleanupHandle;
 
 	UProjectileSubsystem();
@@ -73,16 +266,47 @@ public:
 		return UWorld::GetSubsystem<UProjectileSubsystem>(World);
 	}
 
-	/** spawns a new projectile to be simulated */
-	FProjectileHandle CreateProjectile(UProjectileConfig* Config, const FVector& Location, const FRotator& Rotation);
-	/** destroys the projectile. cannot be called inside this subsystem Tick */
+	/** spawns a new projectile to be simulated. pass an id from RegisterOwner to get notified when it's destroyed.
+		the handle is invalid when the spawn was rejected, see SaturationHeadroom */
+	FProjectileHandle CreateProjectile(UProjectileConfig* Config, const FVector& Location, const FRotator& Rotation, uint16 OwnerId = 0);
+	/** destroys the projectile. cannot be called inside this subsystem Tick. between the submit and
+		consume ticks the destroy is deferred to the consume tick, in deterministic mode to the next submit tick */
 	void DestroyProjectile(FProjectileHandle Handle);
 	/** gets the internal simulation state for a projectile. will return a stub if the
-		handle is valid so the code works. use IsProjectileValid for actual error handling */
+		handle is valid so the code works. use IsProjectileValid for actual error handling.
+		the sweep task owns the states between the submit and consume ticks, don't touch them in there */
 	FProjectileState* GetProjectileState(FProjectileHandle Handle);
 	/** test if the handle refers to a valid projectile */
 	bool IsProjectileValid(FProjectileHandle Handle) const;
 
+	/** turns an actorless projectile into a pooled actor that continues its flight, for the part of its life
+		that needs full actor behaviour. the owner gets a Promoted destroy event for the handle.
+		ends the tick in flight early if called between the submit and consume ticks */
+	AActorProjectile* PromoteProjectile(FProjectileHandle Handle, TSubclassOf<AActorProjectile> Class);
+	/** turns an actor projectile back into an actorless one that continues its flight, the actor goes back to the pool.
+		when the actorless one is rejected (out of budget) the actor keeps flying and the handle is invalid */
+	FProjectileHandle DemoteProjectile(AActorProjectile* Actor, uint16 OwnerId = 0);
+
+	/** latest published projectile state, safe to read from any thread with FProjectileSnapshotReadScope.
+		only filled with bPublishSnapshots */
+	FProjectileSnapshotBuffer& GetSnapshots() { return Simulation.Snapshots; }
+
+	/** allocates room for the config's ExpectedPeakCount projectiles up front. configs placed in the level are
+		reserved when play begins, call this while loading for the ones that show up later (weapons etc).
+		once every registered config has a budget the handle table is sized to their sum */
+	void ReserveConfig(UProjectileConfig* Config);
+
+	/** queues a debug line for an actor projectile, drawn with the actorless ones in one batch. game thread only */
+	void DrawActorDebugLine(const FVector& Start, const FVector& End, const FColor& Color);
+
+	/** appends every projectile within Radius of Center. the index behind the queries is only built on
+		frames where somebody queries. between the submit and consume ticks this sees the previous frame */
+	void QueryRadius(const FVector& Center, float Radius, TArray<FProjectileHandle>& OutHandles);
+	/** appends every projectile inside Box */
+	void QueryBox(const FBox& Box, TArray<FProjectileHandle>& OutHandles);
+	/** appends every projectile within Radius of the segment from Start to End */
+	void QuerySegment(const FVector& Start, const FVector& End, float Radius, TArray<FProjectileHandle>& OutHandles);
+
 	// ~ begin USubsystem interface
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
@@ -92,7 +316,38 @@ public:
 	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
 	// ~ end UWorldSubsystem interface
 
-	int32 GetOrCreateChunk(UProjectileConfig* Config);
+	/** registers an owner for destroy notifications and returns the id to pass to CreateProjectile.
+		ids of unregistered owners are reused */
+	uint16 RegisterOwner(IProjectileOwner* Owner);
+	/** stops notifications. projectiles still alive with this owner id keep flying without an owner,
+		so they can't notify whoever gets the id next */
+	void UnregisterOwner(uint16 OwnerId);
+
+	/** makes the actor something homing projectiles can lock on to. returns 0 if there are too many targets */
+	uint16 RegisterTarget(AActor* Actor);
+	void UnregisterTarget(uint16 TargetId);
+
+	/** stream a snapshot of every frame to Filename until StopRecording is called */
+	void StartRecording(const FString& Filename);
+	void StopRecording();
+
+	/** config the chunk was created for */
+	UProjectileConfig* GetChunkConfig(const FProjectileChunk& Chunk) const { return Configs[Chunk.ConfigId]; }
+
+	uint16 GetOrAddConfigId(UProjectileConfig* Config);
+	void UpdateTargets();
+	void DispatchDestroyEvents();
+	/** tells the simulation where the players are, EvictFarthest evicts away from them */
+	void UpdateEvictionFocus();
+	/** checks the cells the simulation has projectiles in against world partition streaming, every StreamingCheckInterval */
+	void UpdateUnloadedCells(float DeltaTime);
+	/** reserves every config referenced by the level and logs the committed budget */
+	void ReserveLevelConfigs(UWorld& InWorld);
+	/** applies the damage of every explosion from the last tick, one overlap query per cluster */
+	void ResolveExplosions();
 	void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
-	void Tick(float DeltaTime);
+	/** blocks until the tick in flight is done and ends it */
+	void FinishTick();
+	void SubmitTick(float DeltaTime);
+	void ConsumeTick(float DeltaTime);
 };
@@ -0,0 +1,32 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#include "ProjectileTargetComponent.h"
+#include "ProjectileSubsystem.h"
+
+UProjectileTargetComponent::UProjectileTargetComponent()
+{
+	// the subsystem reads the owner location itself
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UProjectileTargetComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld()))
+	{
+		TargetId = Subsystem->RegisterTarget(GetOwner());
+	}
+}
+
+void UProjectileTargetComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UProjectileSubsystem* Subsystem = UProjectileSubsystem::Get(GetWorld()))
+	{
+		Subsystem->UnregisterTarget(TargetId);
+	}
+
+	TargetId = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,27 @@
+// Copyright Dennis Andersson. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ProjectileTargetComponent.generated.h"
+
+/**
+ * Makes the owning actor something homing actorless projectiles can lock on to
+ */
+UCLASS(ClassGroup=(Projectile), Meta=(BlueprintSpawnableComponent))
+class PROJECTILEPERF_API UProjectileTargetComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	uint16 TargetId = 0;	// id in the projectile subsystem, 0 while not registered
+
+	UProjectileTargetComponent();
+
+	// ~ begin UActorComponent interface
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// ~ end UActorComponent interface
+};
@@ -9,6 +9,6 @@ public class ProjectilePerfEditorTarget : TargetRules
 	{
 		Type = TargetType.Editor;
 		DefaultBuildSettings = BuildSettingsVersion.V2;
-		ExtraModuleNames.Add("ProjectilePerf");
+		ExtraModuleNames.AddRange(new string[] { "ProjectilePerf", "ProjectileCore" });
 	}
 }